@@ -41,7 +41,12 @@
 	Copyright  2002 Apple Computer, Inc., All Rights Reserved
 */
 
+#include <pthread.h>
+
 #include "CustomToolbarItem.h"
+#include "ToolbarQueue.h"
+#include "ToolbarStats.h"
+#include "ToolbarURL.h"
 
 const EventTypeSpec kEvents[] = 
 {
@@ -58,7 +63,8 @@ const EventTypeSpec kEvents[] =
 struct CustomToolbarItem
 {
 	HIToolbarItemRef		toolbarItem;
-	CFURLRef				url;
+	CFURLRef				url;			// NULL if our string isn't a valid URL
+	CFStringRef				string;			// what we save, and show as help
 };
 typedef struct CustomToolbarItem CustomToolbarItem;
 
@@ -67,6 +73,10 @@ static void				DestructCustomToolbarItem( CustomToolbarItem* inItem );
 static OSStatus			InitializeCustomToolbarItem( CustomToolbarItem* inItem,  EventRef inEvent );
 static CFTypeRef		CreateCustomToolbarItemPersistentData( CustomToolbarItem* inItem );
 static pascal OSStatus	CustomToolbarItemHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+static OSStatus			OpenCustomToolbarItemURL( CustomToolbarItem* inItem );
+static SInt32			GetURLStatsBytes( CFStringRef inString );
+static void*			OpenURLThread( void* inURL );
+static void				OpenURLFinished( void* inResult );
 
 //-----------------------------------------------------------------------------
 //	RegisterCustomToolbarItemClass
@@ -139,6 +149,9 @@ ConstructCustomToolbarItem( HIToolbarItemRef inItem, CustomToolbarItem** outItem
 	
 	item->toolbarItem = inItem;
 	item->url = NULL;
+	item->string = NULL;
+	
+	ToolbarStatsAdd( kToolbarStatsCustomItems, 1, sizeof( CustomToolbarItem ) );
 	
 	*outItem = item;
 
@@ -154,9 +167,16 @@ CantAllocItem:
 static void
 DestructCustomToolbarItem( CustomToolbarItem* inItem )
 {
+	if ( inItem->string )
+	{
+		ToolbarStatsAdd( kToolbarStatsURLs, -1, -GetURLStatsBytes( inItem->string ) );
+		CFRelease( inItem->string );
+	}
+	
 	if ( inItem->url )
 		CFRelease( inItem->url );
 
+	ToolbarStatsAdd( kToolbarStatsCustomItems, -1, -(SInt32)sizeof( CustomToolbarItem ) );
 	free( inItem );
 }
 
@@ -171,30 +191,52 @@ static OSStatus
 InitializeCustomToolbarItem( CustomToolbarItem* inItem, EventRef inEvent )
 {
 	CFTypeRef		data;
-	IconRef			iconRef;
+	CFStringRef		string;
+	static IconRef	sIconRef;
+	
+	// The config data can come from another copy of the app, so anything
+	// that isn't a string or a URL is ignored.
 	
+	string = CFSTR( "http://www.apple.com" );
 	if ( GetEventParameter( inEvent, kEventParamToolbarItemConfigData, typeCFTypeRef, NULL,
-			sizeof( CFTypeRef ), NULL, &data ) == noErr )
+			sizeof( CFTypeRef ), NULL, &data ) == noErr && data != NULL )
 	{
 		if ( CFGetTypeID( data ) == CFStringGetTypeID() )
-			inItem->url = CFURLCreateWithString( NULL, (CFStringRef)data, NULL );
-		else
-			inItem->url = (CFURLRef)CFRetain( data );
-	}
-	else
-	{
-		inItem->url = CFURLCreateWithString( NULL, CFSTR( "http://www.apple.com" ), NULL );
+			string = (CFStringRef)data;
+		else if ( CFGetTypeID( data ) == CFURLGetTypeID() )
+			string = CFURLGetString( (CFURLRef)data );
 	}
+	
+	// Whether we were handed a string (from our saved config) or a URL (from
+	// a drag), we keep the normalized form, so the same address always looks
+	// and saves the same way. If it isn't a valid URL, we keep the string as
+	// we got it. The item does nothing when clicked, but it still saves what
+	// the user gave it, rather than turning into some other URL next time.
+	
+	inItem->url = CreateNormalizedURL( string );
+	if ( inItem->url )
+		string = CFURLGetString( inItem->url );
+	
+	inItem->string = (CFStringRef)CFRetain( string );
+	ToolbarStatsAdd( kToolbarStatsURLs, 1, GetURLStatsBytes( inItem->string ) );
 
 	HIToolbarItemSetLabel( inItem->toolbarItem, CFSTR( "URL Item" ) );
 	
-	if ( GetIconRef( kOnSystemDisk, kSystemIconsCreator, kGenericURLIcon, &iconRef ) == noErr )
+	// All of our items share the same icon, so we only look it up once. The
+	// items retain it as they need it.
+	
+	if ( sIconRef == NULL )
 	{
-		HIToolbarItemSetIconRef( inItem->toolbarItem, iconRef );
-		ReleaseIconRef( iconRef );
+		if ( GetIconRef( kOnSystemDisk, kSystemIconsCreator, kGenericURLIcon, &sIconRef ) == noErr )
+			ToolbarStatsAdd( kToolbarStatsIcons, 1, 0 );
+		else
+			sIconRef = NULL;
 	}
 	
-	HIToolbarItemSetHelpText( inItem->toolbarItem, CFURLGetString( inItem->url ), NULL );
+	if ( sIconRef != NULL )
+		HIToolbarItemSetIconRef( inItem->toolbarItem, sIconRef );
+	
+	HIToolbarItemSetHelpText( inItem->toolbarItem, inItem->string, NULL );
 	
 	return noErr;
 }
@@ -262,10 +304,7 @@ CustomToolbarItemHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void*
 					break;
 		
 				case kEventToolbarItemPerformAction:
-					if ( object->url )
-						result = LSOpenCFURLRef( object->url, NULL );
-					else
-						result = noErr;
+					result = OpenCustomToolbarItemURL( object );
 					break;
 			}
 			break;
@@ -282,15 +321,96 @@ CustomToolbarItemHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void*
 //	to preferences. It is your chance to save any extra data with the item. You
 //	must make sure the data is something that can be saved to XML.
 //
+//	The toolbar history asks for this every time the toolbar changes, so we
+//	hand back our string rather than a copy. It never changes once we are set
+//	up, and was normalized then (if it is a valid URL at all).
+//
 static CFTypeRef
 CreateCustomToolbarItemPersistentData( CustomToolbarItem* inItem )
 {
 	CFTypeRef	result = NULL;
 
+	if ( inItem->string )
+		result = (CFTypeRef)CFRetain( inItem->string );
+	
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	OpenCustomToolbarItemURL
+//-----------------------------------------------------------------------------
+//	Opening a URL can mean launching the browser, which can take a while. So
+//	that the toolbar doesn't hang while that happens, we open the URL on a
+//	thread of its own and hear back about it through the toolbar queue.
+//
+static OSStatus
+OpenCustomToolbarItemURL( CustomToolbarItem* inItem )
+{
+	OSStatus			err = noErr;
+	pthread_attr_t		attr;
+	pthread_t			thread;
+	
 	if ( inItem->url )
 	{
-		return (CFTypeRef)CFStringCreateCopy( NULL, CFURLGetString( inItem->url ) ); 
+		CFRetain( inItem->url );
+		
+		pthread_attr_init( &attr );
+		pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+		
+		if ( pthread_create( &thread, &attr, OpenURLThread, (void*)inItem->url ) != 0 )
+		{
+			// No thread for us; just do it the slow way.
+			
+			err = LSOpenCFURLRef( inItem->url, NULL );
+			CFRelease( inItem->url );
+		}
+		
+		pthread_attr_destroy( &attr );
 	}
 	
-	return result;
+	return err;
+}
+
+//-----------------------------------------------------------------------------
+//	OpenURLThread
+//-----------------------------------------------------------------------------
+//	Open the URL and let the main thread know how it went.
+//
+static void*
+OpenURLThread( void* inURL )
+{
+	OSStatus		err;
+	
+	err = LSOpenCFURLRef( (CFURLRef)inURL, NULL );
+	CFRelease( (CFURLRef)inURL );
+	
+	PostToToolbarQueue( OpenURLFinished, (void*)(intptr_t)err );
+	
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	OpenURLFinished
+//-----------------------------------------------------------------------------
+//	Back on the main thread. The action has long since returned, so the only
+//	way left to tell the user that the URL couldn't be opened is a beep.
+//
+static void
+OpenURLFinished( void* inResult )
+{
+	if ( (OSStatus)(intptr_t)inResult != noErr )
+		SysBeep( 1 );
+}
+
+//-----------------------------------------------------------------------------
+//	GetURLStatsBytes
+//-----------------------------------------------------------------------------
+//	A rough idea of what a URL costs us: the characters of its string. We only
+//	use this for our memory stats, and it must give the same answer for a
+//	string every time.
+//
+static SInt32
+GetURLStatsBytes( CFStringRef inString )
+{
+	return CFStringGetLength( inString ) * sizeof( UniChar );
 }
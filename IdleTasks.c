@@ -0,0 +1,331 @@
+/*
+    File:		IdleTasks.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include "IdleTasks.h"
+#include "ToolbarStats.h"
+
+// Work that doesn't need doing right away is handed to us as a task. We run
+// tasks in short slices while the user is idle, and stop the moment an event
+// shows up in the queue. Tasks are taken by priority, with an earlier
+// deadline breaking ties. A task whose deadline has passed gets run even if
+// the user is busy, one slice at a time, so it can't be put off forever.
+//
+// A task is just a proc that does a little work per call and says when it is
+// done. Anything it needs to pick up where it left off lives in its data.
+
+#define kIdleTaskDelay			( 100 * kEventDurationMillisecond )
+#define kIdleTaskInterval		( 10 * kEventDurationMillisecond )
+#define kIdleTaskSlice			( 5 * kEventDurationMillisecond )
+
+struct IdleTask
+{
+	struct IdleTask*	next;
+	IdleTaskProcPtr		proc;
+	void*				data;
+	UInt32				priority;
+	EventTime			deadline;
+};
+typedef struct IdleTask IdleTask;
+
+static IdleTask*			sTasks;
+static EventLoopTimerRef	sDeadlineTimer;
+static IdleTaskStats		sStats;
+
+static void				RunIdleTasks( Boolean inOverdueOnly );
+static IdleTask*		NextIdleTask( Boolean inOverdueOnly, EventTime inNow );
+static void				ResetDeadlineTimer();
+static void				IdleTaskTimer( EventLoopTimerRef inTimer, EventLoopIdleTimerMessage inState, void* inUserData );
+static void				DeadlineTimer( EventLoopTimerRef inTimer, void* inUserData );
+static CFDictionaryRef	CopyIdleTaskStatsSection();
+
+//-----------------------------------------------------------------------------
+//	InstallIdleTasks
+//-----------------------------------------------------------------------------
+//	Set up the timers that drive our tasks. Call this once, from main.
+//
+void
+InstallIdleTasks()
+{
+	InstallEventLoopIdleTimer( GetMainEventLoop(), kIdleTaskDelay, kIdleTaskInterval,
+			NewEventLoopIdleTimerUPP( IdleTaskTimer ), NULL, NULL );
+	
+	InstallEventLoopTimer( GetMainEventLoop(), kEventDurationForever, kEventDurationForever,
+			NewEventLoopTimerUPP( DeadlineTimer ), NULL, &sDeadlineTimer );
+	
+	InstallToolbarStatsSection( CFSTR( "idleTasks" ), CopyIdleTaskStatsSection );
+}
+
+//-----------------------------------------------------------------------------
+//	ScheduleIdleTask
+//-----------------------------------------------------------------------------
+//	Add a task. The deadline is an absolute event time; pass
+//	kEventDurationForever if the task can wait as long as it has to. If the
+//	same proc and data are already scheduled, we just update that task, so
+//	callers don't need to keep track of whether they asked already.
+//
+void
+ScheduleIdleTask( IdleTaskProcPtr inProc, void* inData, UInt32 inPriority, EventTime inDeadline )
+{
+	IdleTask*		task;
+	
+	for ( task = sTasks; task != NULL; task = task->next )
+	{
+		if ( task->proc == inProc && task->data == inData )
+			break;
+	}
+	
+	if ( task == NULL )
+	{
+		task = (IdleTask*)malloc( sizeof( IdleTask ) );
+		require( task != NULL, CantAllocTask );
+		
+		task->proc = inProc;
+		task->data = inData;
+		task->next = sTasks;
+		task->deadline = kEventDurationForever;
+		task->priority = inPriority;
+		sTasks = task;
+	}
+	
+	if ( inPriority < task->priority )
+		task->priority = inPriority;
+	
+	if ( inDeadline != kEventDurationForever
+			&& ( task->deadline == kEventDurationForever || inDeadline < task->deadline ) )
+		task->deadline = inDeadline;
+	
+	ResetDeadlineTimer();
+
+CantAllocTask:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	GetIdleTaskStats
+//-----------------------------------------------------------------------------
+//	How much time we've been spending on idle work, and how badly it could
+//	have held up events that came in while we were at it.
+//
+void
+GetIdleTaskStats( IdleTaskStats* outStats )
+{
+	*outStats = sStats;
+}
+
+//-----------------------------------------------------------------------------
+//	CopyIdleTaskStatsSection
+//-----------------------------------------------------------------------------
+//	Our stats for the stats dump, with times in nanoseconds. longestStep is
+//	the figure to watch: it is the longest an event could have waited on us.
+//
+static CFDictionaryRef
+CopyIdleTaskStatsSection()
+{
+	CFMutableDictionaryRef	result;
+	
+	result = CFDictionaryCreateMutable( NULL, 7,
+			&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	require( result != NULL, CantCreateResult );
+	
+	AddToolbarStatsValue( result, CFSTR( "slices" ), sStats.slices );
+	AddToolbarStatsValue( result, CFSTR( "yields" ), sStats.yields );
+	AddToolbarStatsValue( result, CFSTR( "steps" ), sStats.steps );
+	AddToolbarStatsValue( result, CFSTR( "overdueSteps" ), sStats.overdueSteps );
+	AddToolbarStatsValue( result, CFSTR( "totalSliceTime" ),
+			(SInt64)( sStats.totalSliceTime / kEventDurationNanosecond ) );
+	AddToolbarStatsValue( result, CFSTR( "longestSlice" ),
+			(SInt64)( sStats.longestSlice / kEventDurationNanosecond ) );
+	AddToolbarStatsValue( result, CFSTR( "longestStep" ),
+			(SInt64)( sStats.longestStep / kEventDurationNanosecond ) );
+
+CantCreateResult:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	RunIdleTasks
+//-----------------------------------------------------------------------------
+//	Run one slice. We keep calling the most important task until the slice is
+//	used up, we run out of tasks, or an event arrives.
+//
+static void
+RunIdleTasks( Boolean inOverdueOnly )
+{
+	EventTime		start = GetCurrentEventTime();
+	EventTime		now = start;
+	EventTime		elapsed;
+	IdleTask*		task;
+	
+	if ( sTasks == NULL )
+		return;
+	
+	sStats.slices++;
+	
+	while ( now - start < kIdleTaskSlice && ( task = NextIdleTask( inOverdueOnly, now ) ) != NULL )
+	{
+		EventTime		stepStart = now;
+		Boolean			done;
+		
+		if ( task->deadline != kEventDurationForever && task->deadline <= now )
+			sStats.overdueSteps++;
+		sStats.steps++;
+		
+		done = task->proc( task->data );
+		
+		now = GetCurrentEventTime();
+		if ( now - stepStart > sStats.longestStep )
+			sStats.longestStep = now - stepStart;
+		
+		if ( done )
+		{
+			IdleTask**		link;
+			
+			for ( link = &sTasks; *link != task; link = &(*link)->next )
+				;
+			*link = task->next;
+			free( task );
+		}
+		
+		if ( GetNumEventsInQueue( GetMainEventQueue() ) > 0 )
+		{
+			sStats.yields++;
+			break;
+		}
+	}
+	
+	elapsed = now - start;
+	sStats.totalSliceTime += elapsed;
+	if ( elapsed > sStats.longestSlice )
+		sStats.longestSlice = elapsed;
+	
+	ResetDeadlineTimer();
+}
+
+//-----------------------------------------------------------------------------
+//	NextIdleTask
+//-----------------------------------------------------------------------------
+//	Pick the task to run next: overdue tasks first, then by priority, then by
+//	deadline.
+//
+static IdleTask*
+NextIdleTask( Boolean inOverdueOnly, EventTime inNow )
+{
+	IdleTask*		best = NULL;
+	Boolean			bestOverdue = false;
+	IdleTask*		task;
+	
+	for ( task = sTasks; task != NULL; task = task->next )
+	{
+		Boolean		overdue = task->deadline != kEventDurationForever && task->deadline <= inNow;
+		
+		if ( inOverdueOnly && !overdue )
+			continue;
+		
+		if ( best == NULL
+				|| ( overdue && !bestOverdue )
+				|| ( overdue == bestOverdue && task->priority < best->priority )
+				|| ( overdue == bestOverdue && task->priority == best->priority
+					&& task->deadline != kEventDurationForever
+					&& ( best->deadline == kEventDurationForever || task->deadline < best->deadline ) ) )
+		{
+			best = task;
+			bestOverdue = overdue;
+		}
+	}
+	
+	return best;
+}
+
+//-----------------------------------------------------------------------------
+//	ResetDeadlineTimer
+//-----------------------------------------------------------------------------
+//	Arrange to be woken up when the earliest deadline comes around.
+//
+static void
+ResetDeadlineTimer()
+{
+	EventTime		earliest = kEventDurationForever;
+	EventTime		now = GetCurrentEventTime();
+	IdleTask*		task;
+	
+	if ( sDeadlineTimer == NULL )
+		return;
+	
+	for ( task = sTasks; task != NULL; task = task->next )
+	{
+		if ( task->deadline != kEventDurationForever
+				&& ( earliest == kEventDurationForever || task->deadline < earliest ) )
+			earliest = task->deadline;
+	}
+	
+	if ( earliest == kEventDurationForever )
+		SetEventLoopTimerNextFireTime( sDeadlineTimer, kEventDurationForever );
+	else if ( earliest <= now )
+		SetEventLoopTimerNextFireTime( sDeadlineTimer, kIdleTaskInterval );
+	else
+		SetEventLoopTimerNextFireTime( sDeadlineTimer, earliest - now );
+}
+
+//-----------------------------------------------------------------------------
+//	IdleTaskTimer
+//-----------------------------------------------------------------------------
+//	The user isn't doing anything. Get some work done.
+//
+static void
+IdleTaskTimer( EventLoopTimerRef inTimer, EventLoopIdleTimerMessage inState, void* inUserData )
+{
+	if ( inState == kEventLoopIdleTimerIdling )
+		RunIdleTasks( false );
+}
+
+//-----------------------------------------------------------------------------
+//	DeadlineTimer
+//-----------------------------------------------------------------------------
+//	Something is overdue. Give overdue tasks a slice whether the user is idle
+//	or not.
+//
+static void
+DeadlineTimer( EventLoopTimerRef inTimer, void* inUserData )
+{
+	RunIdleTasks( true );
+}
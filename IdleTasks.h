@@ -0,0 +1,87 @@
+/*
+    File:		IdleTasks.h
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#ifndef CarbonToolbar_IDLETASKS
+#define CarbonToolbar_IDLETASKS
+
+#include <Carbon/Carbon.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An idle task does a small piece of its work each time it is called, and
+// returns true once it has nothing left to do.
+
+typedef Boolean (*IdleTaskProcPtr)( void* inData );
+
+enum
+{
+	kIdleTaskPriorityHigh		= 0,
+	kIdleTaskPriorityNormal		= 1,
+	kIdleTaskPriorityLow		= 2
+};
+
+// These also appear in the stats dump, under "idleTasks".
+
+struct IdleTaskStats
+{
+	UInt32			slices;				// times we got to run tasks
+	UInt32			yields;				// slices cut short by a waiting event
+	UInt32			steps;				// calls made to task procs
+	UInt32			overdueSteps;		// calls made because a deadline passed
+	EventTime		totalSliceTime;
+	EventTime		longestSlice;
+	EventTime		longestStep;		// the most we could have delayed an event
+};
+typedef struct IdleTaskStats IdleTaskStats;
+
+extern void					InstallIdleTasks();
+extern void					ScheduleIdleTask( IdleTaskProcPtr inProc, void* inData, UInt32 inPriority, EventTime inDeadline );
+extern void					GetIdleTaskStats( IdleTaskStats* outStats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CarbonToolbar_IDLETASKS
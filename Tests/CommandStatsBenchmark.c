@@ -0,0 +1,136 @@
+/*
+    File:		CommandStatsBenchmark.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+// Measures what timing a command costs: the clock read before dispatch plus
+// ToolbarStatsNoteCommand after it, over a made-up stream of the commands
+// the app sends. It only needs ToolbarStats.c, so it builds and runs on its
+// own, outside the app:
+//
+//		cc -O2 -o /tmp/CommandStatsBenchmark -I. Tests/CommandStatsBenchmark.c ToolbarStats.c -framework Carbon
+//		/tmp/CommandStatsBenchmark
+//
+// The exit status is 1 if an event costs more than the 20 nanoseconds we
+// allow for it. Most of that goes on the two clock reads, which cost very
+// different amounts on different machines, so their share is printed too.
+
+#include <stdio.h>
+#include <mach/mach_time.h>
+
+#include "ToolbarStats.h"
+
+#define kBudgetNanoseconds		20.0
+#define kEventCount				10000000
+#define kRunCount				5
+
+// Roughly the mix the app sees: mostly the toolbar's own items, with the
+// odd lock, unlock and new window.
+
+static const UInt32 kCommandStream[] =
+{
+	kHICommandCut, 'SHRT', 'TRSH', kHICommandCut, 'SHRT', kHICommandCut,
+	'TRSH', 'SHRT', kHICommandNew, kHICommandCut, 'Lock', 'SHRT',
+	'TRSH', 'ULck', kHICommandCut, 'METL'
+};
+
+#define kCommandStreamCount		( sizeof( kCommandStream ) / sizeof( kCommandStream[0] ) )
+
+static volatile UInt64		sSink;
+
+static double			TimeEvents( Boolean inNoteCommands );
+
+//-----------------------------------------------------------------------------
+//	main
+//-----------------------------------------------------------------------------
+//	Time several runs of each and go by the best, since the others are more
+//	likely to have been interrupted.
+//
+int
+main( int argc, char* argv[] )
+{
+	double		perEvent, clocks;
+	
+	clocks = TimeEvents( false );
+	perEvent = TimeEvents( true );
+	
+	printf( "%.1f ns per event (%.1f ns of it reading the clock), budget %.0f ns\n",
+			perEvent, clocks, kBudgetNanoseconds );
+	
+	return perEvent > kBudgetNanoseconds;
+}
+
+//-----------------------------------------------------------------------------
+//	TimeEvents
+//-----------------------------------------------------------------------------
+//	The best time per event over our runs. Without inNoteCommands we only do
+//	the clock reads, to see what they cost on their own.
+//
+static double
+TimeEvents( Boolean inNoteCommands )
+{
+	double		best = 0;
+	int			run;
+	
+	for ( run = 0; run < kRunCount; run++ )
+	{
+		UInt64		start = mach_absolute_time();
+		UInt32		i;
+		double		perEvent;
+		
+		if ( inNoteCommands )
+		{
+			for ( i = 0; i < kEventCount; i++ )
+				ToolbarStatsNoteCommand( kCommandStream[ i % kCommandStreamCount ], mach_absolute_time() );
+		}
+		else
+		{
+			for ( i = 0; i < kEventCount; i++ )
+				sSink = mach_absolute_time() + mach_absolute_time();
+		}
+		
+		perEvent = (double)GetToolbarStatsNanoseconds( mach_absolute_time() - start ) / kEventCount;
+		if ( run == 0 || perEvent < best )
+			best = perEvent;
+	}
+	
+	return best;
+}
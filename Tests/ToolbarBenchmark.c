@@ -0,0 +1,473 @@
+/*
+    File:		ToolbarBenchmark.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+// Times the parts of the toolbar code that only need CoreFoundation, so they
+// can be measured without a window server, and prints the results as JSON.
+// Given the output of an earlier run as a baseline, it also reports anything
+// that got slower by more than a threshold (10 percent unless given):
+//
+//		cc -O2 -o /tmp/ToolbarBenchmark -I. Tests/ToolbarBenchmark.c ToolbarCatalog.c ToolbarStats.c ToolbarURL.c -framework Carbon
+//		/tmp/ToolbarBenchmark > /tmp/ToolbarBaseline.json
+//		/tmp/ToolbarBenchmark /tmp/ToolbarBaseline.json 10
+//
+// The mirror's edit scripts and the idle task picker are private to their
+// files, so we include those files here rather than export them just for
+// this. Regressions are printed to stderr, and the exit status is the number
+// of them. Anything that makes toolbars or items needs the Toolbox, and is
+// left to the app's own stats dump.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mach/mach_time.h>
+
+// Both files keep their counters in a static called sStats.
+
+#define sStats		sIdleTaskStats
+#include "IdleTasks.c"
+#undef sStats
+
+#define sStats		sMirrorStats
+#include "ToolbarMirror.c"
+#undef sStats
+
+#include "ToolbarCatalog.h"
+#include "ToolbarStats.h"
+#include "ToolbarURL.h"
+
+#define kRunCount				5
+#define kDefaultThreshold		10.0		// percent
+#define kItemCount				64			// items in the mirrored toolbar
+#define kTaskCount				32			// idle tasks waiting
+
+struct Benchmark
+{
+	const char*		name;
+	void			(*proc)( UInt32 inCount );
+	UInt32			count;			// operations per run
+};
+typedef struct Benchmark Benchmark;
+
+static void				BenchNormalizeURL( UInt32 inCount );
+static void				BenchNoteCommand( UInt32 inCount );
+static void				BenchFindCatalogEntry( UInt32 inCount );
+static void				BenchCreateItemEdits( UInt32 inCount );
+static void				BenchCreateItemsFromEdits( UInt32 inCount );
+static void				BenchNextIdleTask( UInt32 inCount );
+static void				BenchRescheduleIdleTask( UInt32 inCount );
+
+static const Benchmark kBenchmarks[] =
+{
+	{ "url.normalize",				BenchNormalizeURL,			100000 },
+	{ "stats.noteCommand",			BenchNoteCommand,			10000000 },
+	{ "catalog.find",				BenchFindCatalogEntry,		1000000 },
+	{ "mirror.createEdits",			BenchCreateItemEdits,		10000 },
+	{ "mirror.createItemsFromEdits",	BenchCreateItemsFromEdits,	10000 },
+	{ "idle.nextTask",				BenchNextIdleTask,			1000000 },
+	{ "idle.reschedule",			BenchRescheduleIdleTask,	1000000 }
+};
+
+#define kBenchmarkCount			( sizeof( kBenchmarks ) / sizeof( kBenchmarks[0] ) )
+
+// What users type into a URL item, good and bad.
+
+static const CFStringRef kURLStrings[] =
+{
+	CFSTR( "http://www.apple.com/" ),
+	CFSTR( "HTTP://WWW.Apple.COM:80/Path/File.HTML" ),
+	CFSTR( "www.apple.com:8080/developer" ),
+	CFSTR( "https://[FE80::1]:8443/x" ),
+	CFSTR( "file:///Users/Shared/a%20b.txt" ),
+	CFSTR( "http://apple.com/%zz" )
+};
+
+#define kURLStringCount			( sizeof( kURLStrings ) / sizeof( kURLStrings[0] ) )
+
+// The commands the app sends, as in CommandStatsBenchmark.c.
+
+static const UInt32 kCommandStream[] =
+{
+	kHICommandCut, 'SHRT', 'TRSH', kHICommandCut, 'SHRT', kHICommandCut,
+	'TRSH', 'SHRT', kHICommandNew, kHICommandCut, 'Lock', 'SHRT',
+	'TRSH', 'ULck', kHICommandCut, 'METL'
+};
+
+#define kCommandStreamCount		( sizeof( kCommandStream ) / sizeof( kCommandStream[0] ) )
+
+// Our own items, and Toolbox items we don't define.
+
+static const CFStringRef kLookupIdentifiers[] =
+{
+	CFSTR( "com.apple.carbontoolbar.anchored" ),
+	kHIToolbarSeparatorIdentifier,
+	CFSTR( "com.apple.carbontoolbar.permanent" ),
+	kHIToolbarFlexibleSpaceIdentifier,
+	CFSTR( "com.apple.carbontoolbar.trash" ),
+	CFSTR( "MyCustomIdentifier" ),
+	kHIToolbarCustomizeIdentifier,
+	CFSTR( "com.apple.carbontoolbar.newdocument" )
+};
+
+#define kLookupIdentifierCount	( sizeof( kLookupIdentifiers ) / sizeof( kLookupIdentifiers[0] ) )
+
+static CFArrayRef			sBaseItems;
+static CFArrayRef			sChangedItems;
+static CFArrayRef			sEdits;
+static const void* volatile	sSink;
+
+static void				SetUpFixtures();
+static CFArrayRef		CreateTestItems( CFIndex inCount, CFIndex inFirst );
+static Boolean			IdleNop( void* inData );
+static double			TimeBenchmark( const Benchmark* inBenchmark );
+static int				CompareWithBaseline( const char* inPath, const double* inResults, double inThreshold );
+
+//-----------------------------------------------------------------------------
+//	main
+//-----------------------------------------------------------------------------
+//
+int
+main( int argc, char* argv[] )
+{
+	double		results[ kBenchmarkCount ];
+	UInt32		i;
+	
+	SetUpFixtures();
+	
+	printf( "{\n\t\"units\": \"ns/op\",\n\t\"results\": {\n" );
+	
+	for ( i = 0; i < kBenchmarkCount; i++ )
+	{
+		results[ i ] = TimeBenchmark( &kBenchmarks[ i ] );
+		printf( "\t\t\"%s\": %.1f%s\n", kBenchmarks[ i ].name, results[ i ],
+				i + 1 < kBenchmarkCount ? "," : "" );
+	}
+	
+	printf( "\t}\n}\n" );
+	
+	if ( argc < 2 )
+		return 0;
+	
+	return CompareWithBaseline( argv[1], results, argc > 2 ? atof( argv[2] ) : kDefaultThreshold );
+}
+
+//-----------------------------------------------------------------------------
+//	ShareToolbarItems
+//-----------------------------------------------------------------------------
+//	The mirror applies updates from other copies of the app through the
+//	history, which needs windows. We never receive updates here, so this is
+//	never called, but the mirror has to link.
+//
+void
+ShareToolbarItems( WindowRef inSource, CFArrayRef inItems )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	SetUpFixtures
+//-----------------------------------------------------------------------------
+//	A toolbar's worth of items, and the same items after a typical change: two
+//	dragged past each other, one removed and a new one added. And a queue of
+//	idle tasks, some with deadlines.
+//
+static void
+SetUpFixtures()
+{
+	CFMutableArrayRef	changed;
+	CFArrayRef			added;
+	EventTime			now = GetCurrentEventTime();
+	UInt32				i;
+	
+	sBaseItems = CreateTestItems( kItemCount, 0 );
+	
+	changed = CFArrayCreateMutableCopy( NULL, 0, sBaseItems );
+	CFArrayExchangeValuesAtIndices( changed, 1, kItemCount - 2 );
+	CFArrayRemoveValueAtIndex( changed, kItemCount / 2 );
+	added = CreateTestItems( 1, kItemCount );
+	CFArrayAppendValue( changed, CFArrayGetValueAtIndex( added, 0 ) );
+	CFRelease( added );
+	sChangedItems = changed;
+	
+	sEdits = CreateItemEdits( sBaseItems, sChangedItems );
+	
+	for ( i = 0; i < kTaskCount; i++ )
+	{
+		EventTime		deadline = kEventDurationForever;
+		
+		if ( i % 4 == 0 )
+			deadline = now + ( i + 1 ) * kEventDurationSecond;
+		
+		ScheduleIdleTask( IdleNop, (void*)(CFIndex)( i + 1 ), i % 3, deadline );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	CreateTestItems
+//-----------------------------------------------------------------------------
+//	Item descriptors as the history keeps them, each for a URL item with its
+//	own address.
+//
+static CFArrayRef
+CreateTestItems( CFIndex inCount, CFIndex inFirst )
+{
+	CFMutableArrayRef	result;
+	CFIndex				i;
+	
+	result = CFArrayCreateMutable( NULL, inCount, &kCFTypeArrayCallBacks );
+	
+	for ( i = inFirst; i < inFirst + inCount; i++ )
+	{
+		const void*			keys[] = { kToolbarItemIdentifierKey, kToolbarItemConfigDataKey };
+		const void*			values[2];
+		CFDictionaryRef		item;
+		
+		values[0] = CFSTR( "MyCustomIdentifier" );
+		values[1] = CFStringCreateWithFormat( NULL, NULL, CFSTR( "http://www.apple.com/%ld" ), (long)i );
+		
+		item = CFDictionaryCreate( NULL, keys, values, 2, &kCFTypeDictionaryKeyCallBacks,
+				&kCFTypeDictionaryValueCallBacks );
+		CFArrayAppendValue( result, item );
+		
+		CFRelease( item );
+		CFRelease( values[1] );
+	}
+	
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	IdleNop
+//-----------------------------------------------------------------------------
+//	We only ever pick tasks, never run them.
+//
+static Boolean
+IdleNop( void* inData )
+{
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+//	BenchNormalizeURL
+//-----------------------------------------------------------------------------
+//
+static void
+BenchNormalizeURL( UInt32 inCount )
+{
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+	{
+		CFURLRef	url = CreateNormalizedURL( kURLStrings[ i % kURLStringCount ] );
+		
+		if ( url )
+			CFRelease( url );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	BenchNoteCommand
+//-----------------------------------------------------------------------------
+//	Includes the clock read the dispatcher makes before each command.
+//
+static void
+BenchNoteCommand( UInt32 inCount )
+{
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+		ToolbarStatsNoteCommand( kCommandStream[ i % kCommandStreamCount ], mach_absolute_time() );
+}
+
+//-----------------------------------------------------------------------------
+//	BenchFindCatalogEntry
+//-----------------------------------------------------------------------------
+//
+static void
+BenchFindCatalogEntry( UInt32 inCount )
+{
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+		sSink = FindToolbarCatalogEntry( kLookupIdentifiers[ i % kLookupIdentifierCount ] );
+}
+
+//-----------------------------------------------------------------------------
+//	BenchCreateItemEdits
+//-----------------------------------------------------------------------------
+//	What the mirror does to publish a change.
+//
+static void
+BenchCreateItemEdits( UInt32 inCount )
+{
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+	{
+		CFArrayRef	edits = CreateItemEdits( sBaseItems, sChangedItems );
+		
+		if ( edits )
+			CFRelease( edits );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	BenchCreateItemsFromEdits
+//-----------------------------------------------------------------------------
+//	What the mirror does to apply a change from another copy of the app.
+//
+static void
+BenchCreateItemsFromEdits( UInt32 inCount )
+{
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+	{
+		CFArrayRef	items = CreateItemsFromEdits( sBaseItems, sEdits );
+		
+		if ( items )
+			CFRelease( items );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	BenchNextIdleTask
+//-----------------------------------------------------------------------------
+//	Picking a task, as each step of a slice does. Half way through, the
+//	first deadlines have passed, so both ways through the picker are timed.
+//
+static void
+BenchNextIdleTask( UInt32 inCount )
+{
+	EventTime	now = GetCurrentEventTime();
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+		sSink = NextIdleTask( false, i < inCount / 2 ? now : now + 10 * kEventDurationSecond );
+}
+
+//-----------------------------------------------------------------------------
+//	BenchRescheduleIdleTask
+//-----------------------------------------------------------------------------
+//	Asking again for a task that is already waiting, which callers do rather
+//	than keep track of it themselves.
+//
+static void
+BenchRescheduleIdleTask( UInt32 inCount )
+{
+	UInt32		i;
+	
+	for ( i = 0; i < inCount; i++ )
+		ScheduleIdleTask( IdleNop, (void*)(CFIndex)( i % kTaskCount + 1 ), kIdleTaskPriorityLow, kEventDurationForever );
+}
+
+//-----------------------------------------------------------------------------
+//	TimeBenchmark
+//-----------------------------------------------------------------------------
+//	The best time per operation over our runs, since the others are more
+//	likely to have been interrupted.
+//
+static double
+TimeBenchmark( const Benchmark* inBenchmark )
+{
+	double		best = 0;
+	int			run;
+	
+	for ( run = 0; run < kRunCount; run++ )
+	{
+		UInt64		start = mach_absolute_time();
+		double		perOp;
+		
+		inBenchmark->proc( inBenchmark->count );
+		
+		perOp = (double)GetToolbarStatsNanoseconds( mach_absolute_time() - start ) / inBenchmark->count;
+		if ( run == 0 || perOp < best )
+			best = perOp;
+	}
+	
+	return best;
+}
+
+//-----------------------------------------------------------------------------
+//	CompareWithBaseline
+//-----------------------------------------------------------------------------
+//	Read back a file we wrote earlier and count the results that are more
+//	than inThreshold percent slower than it. We only read our own output, so
+//	we look for one "name": value pair per line rather than parse JSON.
+//	Benchmarks missing from the baseline are new, and pass.
+//
+static int
+CompareWithBaseline( const char* inPath, const double* inResults, double inThreshold )
+{
+	FILE*		file = fopen( inPath, "r" );
+	char		line[ 256 ];
+	int			regressions = 0;
+	
+	if ( file == NULL )
+	{
+		fprintf( stderr, "FAIL: can't read the baseline %s\n", inPath );
+		return 1;
+	}
+	
+	while ( fgets( line, sizeof( line ), file ) != NULL )
+	{
+		char		name[ 64 ];
+		double		baseline;
+		UInt32		i;
+		
+		if ( sscanf( line, " \"%63[^\"]\" : %lf", name, &baseline ) != 2 )
+			continue;
+		
+		for ( i = 0; i < kBenchmarkCount; i++ )
+		{
+			if ( strcmp( name, kBenchmarks[ i ].name ) == 0
+					&& inResults[ i ] > baseline * ( 1.0 + inThreshold / 100.0 ) )
+			{
+				fprintf( stderr, "FAIL: %s takes %.1f ns, up from %.1f ns\n", name, inResults[ i ], baseline );
+				regressions++;
+			}
+		}
+	}
+	
+	fclose( file );
+	
+	return regressions;
+}
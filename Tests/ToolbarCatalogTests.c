@@ -0,0 +1,135 @@
+/*
+    File:		ToolbarCatalogTests.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+// Checks the item catalog for mistakes the app can't catch at run time. Two
+// entries with the same identifier mean one of them can never be made, and
+// the app would carry on without it. Two identifiers with the same CFHash
+// still work, but share a slot in the lookup table. The catalog is constant
+// data and only needs CoreFoundation, so this builds and runs on its own,
+// outside the app; run it whenever the catalog changes:
+//
+//		cc -o /tmp/ToolbarCatalogTests -I. Tests/ToolbarCatalogTests.c ToolbarCatalog.c -framework Carbon
+//		/tmp/ToolbarCatalogTests
+//
+// Each failure is printed, and the exit status is the number of failures.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ToolbarCatalog.h"
+
+static int				CheckEntry( ItemCount inIndex );
+static void				PrintIdentifier( const char* inFormat, CFStringRef inIdentifier );
+
+//-----------------------------------------------------------------------------
+//	main
+//-----------------------------------------------------------------------------
+//
+int
+main( int argc, char* argv[] )
+{
+	ItemCount		i;
+	int				failures = 0;
+	
+	for ( i = 0; i < kToolbarCatalogCount; i++ )
+		failures += CheckEntry( i );
+	
+	printf( "%d of %d catalog entries failed\n", failures, (int)kToolbarCatalogCount );
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	CheckEntry
+//-----------------------------------------------------------------------------
+//	Compare an entry against every entry after it, and make sure looking it
+//	up finds it rather than something else.
+//
+static int
+CheckEntry( ItemCount inIndex )
+{
+	CFStringRef		identifier = kToolbarCatalog[ inIndex ].identifier;
+	CFHashCode		hash = CFHash( identifier );
+	ItemCount		i;
+	int				failures = 0;
+	
+	for ( i = inIndex + 1; i < kToolbarCatalogCount; i++ )
+	{
+		CFStringRef		other = kToolbarCatalog[ i ].identifier;
+		
+		if ( CFEqual( identifier, other ) )
+		{
+			PrintIdentifier( "FAIL: %s is in the catalog twice\n", identifier );
+			failures = 1;
+		}
+		else if ( CFHash( other ) == hash )
+		{
+			PrintIdentifier( "FAIL: %s has the same hash as", identifier );
+			PrintIdentifier( " %s\n", other );
+			failures = 1;
+		}
+	}
+	
+	if ( FindToolbarCatalogEntry( identifier ) != &kToolbarCatalog[ inIndex ] )
+	{
+		PrintIdentifier( "FAIL: looking up %s finds another entry\n", identifier );
+		failures = 1;
+	}
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	PrintIdentifier
+//-----------------------------------------------------------------------------
+//
+static void
+PrintIdentifier( const char* inFormat, CFStringRef inIdentifier )
+{
+	char		buffer[ 256 ];
+	
+	if ( !CFStringGetCString( inIdentifier, buffer, sizeof( buffer ), kCFStringEncodingUTF8 ) )
+		strcpy( buffer, "(unprintable)" );
+	
+	printf( inFormat, buffer );
+}
@@ -0,0 +1,257 @@
+/*
+    File:		ToolbarQueueTests.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+// Tests for the toolbar queue. Several threads post numbered entries as fast
+// as they can while the main thread drains the queue through the event loop,
+// the way the app does. It only needs the Carbon event manager, so this
+// builds and runs on its own, outside the app:
+//
+//		cc -O2 -o /tmp/ToolbarQueueTests -I. Tests/ToolbarQueueTests.c ToolbarQueue.c -framework Carbon
+//		/tmp/ToolbarQueueTests
+//
+// We check that a full ring turns posts away, and that every entry posted
+// is run exactly once and in the order its thread posted it. We also count
+// the wakeup events, to see how well they are coalesced. Each failure is
+// printed, and the exit status is the number of failures.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <libkern/OSAtomic.h>
+
+#include "ToolbarQueue.h"
+
+#define kProducerCount			4
+#define kPostsPerProducer		250000
+#define kRingSize				1024		// kToolbarQueueSize in ToolbarQueue.c
+
+// The queue's wakeup event, as ToolbarQueue.c defines it.
+
+#define kEventClassToolbarQueue	'CTbq'
+#define kEventToolbarQueueDrain	1
+
+// An entry's data is its producer in the top byte and its number in the rest.
+
+#define MakeEntry( p, n )		( (void*)(uintptr_t)( ( (uint32_t)(p) << 24 ) | (uint32_t)(n) ) )
+#define EntryProducer( d )		( (uint32_t)(uintptr_t)(d) >> 24 )
+#define EntryNumber( d )		( (uint32_t)(uintptr_t)(d) & 0x00FFFFFF )
+
+static uint32_t				sNextExpected[ kProducerCount + 1 ];
+static uint32_t				sRun;
+static uint32_t				sOutOfOrder;
+static volatile int32_t		sFullPosts;
+
+static void				RunEntry( void* inData );
+static void*			Producer( void* inProducer );
+static uint32_t			PumpEvents( EventTimeout inTimeout );
+static int				TestFullRing();
+static int				TestProducers();
+
+//-----------------------------------------------------------------------------
+//	main
+//-----------------------------------------------------------------------------
+//
+int
+main( int argc, char* argv[] )
+{
+	int		failures = 0;
+	
+	InstallToolbarQueue();
+	
+	failures += TestFullRing();
+	failures += TestProducers();
+	
+	printf( "%d queue tests failed\n", failures );
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	TestFullRing
+//-----------------------------------------------------------------------------
+//	With nobody draining it, the ring takes exactly kRingSize entries and then
+//	turns posts away. It should only have asked for one wakeup for all of
+//	them, and draining should then run every one.
+//
+static int
+TestFullRing()
+{
+	uint32_t	posted = 0, wakeups;
+	int			failures = 0;
+	
+	while ( posted <= kRingSize && PostToToolbarQueue( RunEntry, MakeEntry( kProducerCount, posted ) ) )
+		posted++;
+	
+	if ( posted != kRingSize )
+	{
+		printf( "FAIL: the ring took %u entries, expected %u\n", posted, kRingSize );
+		failures++;
+	}
+	
+	wakeups = PumpEvents( 0 );
+	
+	if ( wakeups != 1 )
+	{
+		printf( "FAIL: filling the ring asked for %u wakeups, expected 1\n", wakeups );
+		failures++;
+	}
+	if ( sRun != posted || sOutOfOrder != 0 )
+	{
+		printf( "FAIL: ran %u of %u entries, %u out of order\n", sRun, posted, sOutOfOrder );
+		failures++;
+	}
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	TestProducers
+//-----------------------------------------------------------------------------
+//	Several threads post at once while we drain.
+//
+static int
+TestProducers()
+{
+	pthread_t	threads[ kProducerCount ];
+	uint32_t	expected = sRun + kProducerCount * kPostsPerProducer;
+	uint32_t	wakeups = 0;
+	uint32_t	i;
+	int			failures = 0;
+	
+	for ( i = 0; i < kProducerCount; i++ )
+		pthread_create( &threads[ i ], NULL, Producer, (void*)(uintptr_t)i );
+	
+	while ( sRun < expected )
+		wakeups += PumpEvents( 0.1 );
+	
+	for ( i = 0; i < kProducerCount; i++ )
+		pthread_join( threads[ i ], NULL );
+	
+	wakeups += PumpEvents( 0 );
+	
+	for ( i = 0; i < kProducerCount; i++ )
+	{
+		if ( sNextExpected[ i ] != kPostsPerProducer )
+		{
+			printf( "FAIL: producer %u had %u entries run, expected %u\n", i,
+					sNextExpected[ i ], kPostsPerProducer );
+			failures++;
+		}
+	}
+	if ( sRun != expected || sOutOfOrder != 0 )
+	{
+		printf( "FAIL: ran %u of %u entries, %u out of order\n", sRun, expected, sOutOfOrder );
+		failures++;
+	}
+	
+	printf( "%u posts from %d threads took %u wakeups (%.1f posts each); %d posts found the ring full\n",
+			kProducerCount * kPostsPerProducer, kProducerCount, wakeups,
+			(double)( kProducerCount * kPostsPerProducer ) / ( wakeups ? wakeups : 1 ), (int)sFullPosts );
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	Producer
+//-----------------------------------------------------------------------------
+//	Post our numbered entries, waiting for room whenever the ring is full.
+//
+static void*
+Producer( void* inProducer )
+{
+	uint32_t	producer = (uint32_t)(uintptr_t)inProducer;
+	uint32_t	n;
+	
+	for ( n = 0; n < kPostsPerProducer; n++ )
+	{
+		while ( !PostToToolbarQueue( RunEntry, MakeEntry( producer, n ) ) )
+		{
+			OSAtomicIncrement32( &sFullPosts );
+			sched_yield();
+		}
+	}
+	
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	RunEntry
+//-----------------------------------------------------------------------------
+//	Called on the main thread for each entry. Each producer's entries must
+//	come in the order they were posted, with none missing or repeated.
+//
+static void
+RunEntry( void* inData )
+{
+	uint32_t	producer = EntryProducer( inData );
+	
+	if ( EntryNumber( inData ) != sNextExpected[ producer ] )
+		sOutOfOrder++;
+	
+	sNextExpected[ producer ] = EntryNumber( inData ) + 1;
+	sRun++;
+}
+
+//-----------------------------------------------------------------------------
+//	PumpEvents
+//-----------------------------------------------------------------------------
+//	Dispatch the queue's wakeup events until none arrive within inTimeout,
+//	and return how many there were.
+//
+static uint32_t
+PumpEvents( EventTimeout inTimeout )
+{
+	static const EventTypeSpec	kWakeup = { kEventClassToolbarQueue, kEventToolbarQueueDrain };
+	EventRef		event;
+	uint32_t		count = 0;
+	
+	while ( ReceiveNextEvent( 1, &kWakeup, inTimeout, true, &event ) == noErr )
+	{
+		SendEventToEventTarget( event, GetEventDispatcherTarget() );
+		ReleaseEvent( event );
+		count++;
+	}
+	
+	return count;
+}
@@ -0,0 +1,281 @@
+/*
+    File:		ToolbarStatsTests.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+// Checks that the object and byte counters for custom items, their URLs and
+// toolbar snapshots all go back to zero once everything is gone. It makes a
+// hidden window with a toolbar, so it has to run in a login session, but it
+// builds on its own, outside the app:
+//
+//		cc -o /tmp/ToolbarStatsTests -I. Tests/ToolbarStatsTests.c CustomToolbarItem.c ToolbarHistory.c ToolbarQueue.c ToolbarStats.c ToolbarURL.c -framework Carbon
+//		/tmp/ToolbarStatsTests
+//
+// Each failure is printed, and the exit status is the number of failures.
+
+#include <stdio.h>
+
+#include "CustomToolbarItem.h"
+#include "ToolbarHistory.h"
+#include "ToolbarMirror.h"
+#include "ToolbarStats.h"
+
+#define kTestToolbarIdentifier	CFSTR( "com.apple.carbontoolbar.StatsTests" )
+#define kTestItemIdentifier		CFSTR( "com.apple.carbontoolbar.StatsTests.url" )
+
+// Valid and invalid URLs, since the two are kept differently.
+
+static const CFStringRef kTestURLs[] =
+{
+	CFSTR( "http://www.apple.com/" ),
+	CFSTR( "www.apple.com:8080/x" ),
+	CFSTR( "file:///tmp/" ),
+	CFSTR( "not a url" )
+};
+
+#define kTestURLCount			( sizeof( kTestURLs ) / sizeof( kTestURLs[0] ) )
+
+// Loose items never make snapshots, so those are checked last and can be
+// left out of the in-use check.
+
+static const UInt32 kCheckedSubsystems[] =
+{
+	kToolbarStatsCustomItems,
+	kToolbarStatsURLs,
+	kToolbarStatsSnapshots
+};
+
+#define kCheckedCount			( sizeof( kCheckedSubsystems ) / sizeof( kCheckedSubsystems[0] ) )
+
+static const char* kCheckedNames[] =
+{
+	"customItems",
+	"urls",
+	"snapshots"
+};
+
+static const EventTypeSpec kDelegateEvents[] =
+{
+	{ kEventClassToolbar, kEventToolbarCreateItemWithIdentifier }
+};
+
+static int				TestLooseItems();
+static int				TestToolbarWithHistory();
+static int				CheckCounters( const char* inWhen, Boolean inExpectZero, UInt32 inCount );
+static OSStatus			TestDelegateHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+
+//-----------------------------------------------------------------------------
+//	main
+//-----------------------------------------------------------------------------
+//
+int
+main( int argc, char* argv[] )
+{
+	int		failures = 0;
+	
+	failures += CheckCounters( "at the start", true, kCheckedCount );
+	failures += TestLooseItems();
+	failures += TestToolbarWithHistory();
+	
+	printf( "%d stats tests failed\n", failures );
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	PublishToolbarConfig
+//-----------------------------------------------------------------------------
+//	The history passes changes on to the mirror, which would tell any copy of
+//	the app that is running. We stand in for it so the test keeps to itself.
+//
+void
+PublishToolbarConfig( CFDictionaryRef inSnapshot )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	TestLooseItems
+//-----------------------------------------------------------------------------
+//	Items made and released without ever going into a toolbar.
+//
+static int
+TestLooseItems()
+{
+	HIToolbarItemRef	items[ kTestURLCount ];
+	UInt32				i;
+	int					failures = 0;
+	
+	for ( i = 0; i < kTestURLCount; i++ )
+		items[ i ] = CreateCustomToolbarItem( kTestItemIdentifier, kTestURLs[ i ] );
+	
+	failures += CheckCounters( "with loose items", false, kCheckedCount - 1 );
+	
+	for ( i = 0; i < kTestURLCount; i++ )
+	{
+		if ( items[ i ] )
+			CFRelease( items[ i ] );
+	}
+	
+	failures += CheckCounters( "after releasing loose items", true, kCheckedCount );
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	TestToolbarWithHistory
+//-----------------------------------------------------------------------------
+//	Items in a toolbar whose changes are recorded, undone and redone, so that
+//	snapshots are made, shared and dropped, and items are recreated from
+//	them. Everything should be let go of when the window goes.
+//
+static int
+TestToolbarWithHistory()
+{
+	Rect				bounds = { 100, 100, 300, 500 };
+	WindowRef			window;
+	HIToolbarRef		toolbar;
+	UInt32				i;
+	int					failures = 0;
+	
+	require_noerr( CreateNewWindow( kDocumentWindowClass, kWindowStandardHandlerAttribute,
+			&bounds, &window ), CantCreateWindow );
+	require_noerr( HIToolbarCreate( kTestToolbarIdentifier, 0, &toolbar ), CantCreateToolbar );
+	
+	InstallEventHandler( HIObjectGetEventTarget( toolbar ), TestDelegateHandler,
+			GetEventTypeCount( kDelegateEvents ), kDelegateEvents, toolbar, NULL );
+	SetWindowToolbar( window, toolbar );
+	CFRelease( toolbar );
+	
+	InstallToolbarHistory( window );
+	
+	for ( i = 0; i < kTestURLCount; i++ )
+	{
+		HIToolbarItemRef	item = CreateCustomToolbarItem( kTestItemIdentifier, kTestURLs[ i ] );
+		
+		if ( item )
+		{
+			HIToolbarAppendItem( toolbar, item );
+			CFRelease( item );
+		}
+	}
+	
+	HIToolbarRemoveItemAtIndex( toolbar, 0 );
+	HIToolbarRemoveItemAtIndex( toolbar, 1 );
+	ToolbarUndo( window );
+	ToolbarUndo( window );
+	ToolbarRedo( window );
+	
+	failures += CheckCounters( "with a toolbar", false, kCheckedCount );
+	
+	DisposeWindow( window );
+	
+	failures += CheckCounters( "after closing the window", true, kCheckedCount );
+	
+	return failures;
+
+CantCreateToolbar:
+	DisposeWindow( window );
+
+CantCreateWindow:
+	printf( "FAIL: couldn't make a window with a toolbar\n" );
+	return 1;
+}
+
+//-----------------------------------------------------------------------------
+//	CheckCounters
+//-----------------------------------------------------------------------------
+//	Returns how many of the first inCount counters aren't as expected: all
+//	zero, or all in use.
+//
+static int
+CheckCounters( const char* inWhen, Boolean inExpectZero, UInt32 inCount )
+{
+	UInt32		i;
+	int			failures = 0;
+	
+	for ( i = 0; i < inCount; i++ )
+	{
+		ToolbarStatsCounter		counter;
+		Boolean					zero;
+		
+		GetToolbarStats( kCheckedSubsystems[ i ], &counter );
+		zero = ( counter.objects == 0 && counter.bytes == 0 );
+		if ( zero != inExpectZero )
+		{
+			printf( "FAIL: %s, %s has %d objects and %d bytes\n", inWhen, kCheckedNames[ i ],
+					(int)counter.objects, (int)counter.bytes );
+			failures++;
+		}
+	}
+	
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+//	TestDelegateHandler
+//-----------------------------------------------------------------------------
+//	Undo and redo recreate items through the toolbar's delegate, as they do
+//	in the app.
+//
+static OSStatus
+TestDelegateHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
+{
+	CFStringRef			identifier;
+	CFTypeRef			data = NULL;
+	HIToolbarItemRef	item;
+	
+	GetEventParameter( inEvent, kEventParamToolbarItemIdentifier, typeCFStringRef, NULL,
+			sizeof( CFStringRef ), NULL, &identifier );
+	GetEventParameter( inEvent, kEventParamToolbarItemConfigData, typeCFTypeRef, NULL,
+			sizeof( CFTypeRef ), NULL, &data );
+	
+	if ( !CFEqual( identifier, kTestItemIdentifier ) )
+		return eventNotHandledErr;
+	
+	item = CreateCustomToolbarItem( identifier, data );
+	if ( item == NULL )
+		return eventNotHandledErr;
+	
+	SetEventParameter( inEvent, kEventParamToolbarItem, typeHIToolbarItemRef,
+			sizeof( HIToolbarItemRef ), &item );
+	
+	return noErr;
+}
@@ -0,0 +1,203 @@
+/*
+    File:		ToolbarCatalog.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include "ToolbarCatalog.h"
+
+// This is the list of every item we know how to make, along with the sets of
+// items that make up our default toolbar and our configuration palette. To
+// add an item, add an entry here; the delegate in main.c builds items from
+// these entries and needs no changes. Everything here is constant data, so
+// it costs nothing until it is used.
+
+static const CFStringRef kAnchoredMenuItems[] =
+{
+	CFSTR( "Item 1" ),
+	CFSTR( "Item 2" ),
+	CFSTR( "Item 3" ),
+	NULL
+};
+
+const ToolbarCatalogEntry kToolbarCatalog[] =
+{
+	// This item is marked as 'can't be removed'. This means the user can reposition
+	// it in the toolbar, but it can't be dragged out or removed through the toolbar
+	// context menu.
+
+	{ CFSTR( "com.apple.carbontoolbar.permanent" ), kToolbarCatalogStandardItem,
+		CFSTR( "Can't Remove Me" ), kHIToolbarItemCantBeRemoved, 'SHRT',
+		kSystemIconsCreator, kFinderIcon, NULL, NULL },
+
+	// As an example, this item is marked as 'anchored left'. This means that it is not
+	// only immovable, but nothing can be dragged in front of it either. For it to truly
+	// work right, you need to have the items marked as such as the leftmost items. If you
+	// allow a non-anchored item to be to the left of one of these, it gets a little weird.
+	// This attribute is to make toolbars like the one in System Preferences, where the
+	// Show All and the separator after it are fixed in place.
+	//
+	// For this item, we also attach a menu. This menu is used when the item is clipped
+	// (and the 'more items' indicator is showing), as well as when the toolbar is in
+	// text only mode. Its icon comes from our bundle.
+
+	{ CFSTR( "com.apple.carbontoolbar.anchored" ), kToolbarCatalogStandardItem,
+		CFSTR( "Anchored" ), kHIToolbarItemAnchoredLeft, kHICommandCut,
+		'CTba', kHICommandCut, "cut.icns", kAnchoredMenuItems },
+
+	// This item has no fancy stuff at all.
+
+	{ CFSTR( "com.apple.carbontoolbar.trash" ), kToolbarCatalogStandardItem,
+		CFSTR( "Trash" ), kHIToolbarItemNoAttributes, 'TRSH',
+		kSystemIconsCreator, kTrashIcon, NULL, NULL },
+
+	{ CFSTR( "com.apple.carbontoolbar.newdocument" ), kToolbarCatalogStandardItem,
+		CFSTR( "New Document" ), kHIToolbarItemNoAttributes, kHICommandNew,
+		kSystemIconsCreator, kGenericDocumentIcon, NULL, NULL },
+
+	// Our custom URL item sets itself up (see CustomToolbarItem.c).
+
+	{ CFSTR( "MyCustomIdentifier" ), kToolbarCatalogURLItem,
+		NULL, kHIToolbarItemNoAttributes, 0,
+		0, 0, NULL, NULL }
+};
+
+const ItemCount kToolbarCatalogCount = sizeof( kToolbarCatalog ) / sizeof( kToolbarCatalog[0] );
+
+// Note that we are setting our defaults and our allowable items to both items
+// that are defined by us, and items supplied by the Toolbox.
+
+static const CFStringRef kDefaultItems[] =
+{
+	CFSTR( "com.apple.carbontoolbar.anchored" ),
+	kHIToolbarSeparatorIdentifier,
+	CFSTR( "com.apple.carbontoolbar.permanent" ),
+	kHIToolbarFlexibleSpaceIdentifier,
+	CFSTR( "com.apple.carbontoolbar.trash" )
+};
+
+static const CFStringRef kAllowedItems[] =
+{
+	CFSTR( "com.apple.carbontoolbar.newdocument" ),
+	CFSTR( "com.apple.carbontoolbar.anchored" ),
+	CFSTR( "com.apple.carbontoolbar.permanent" ),
+	CFSTR( "com.apple.carbontoolbar.trash" ),
+	kHIToolbarSeparatorIdentifier,
+	kHIToolbarSpaceIdentifier,
+	kHIToolbarFlexibleSpaceIdentifier,
+	kHIToolbarCustomizeIdentifier,
+	kHIToolbarPrintItemIdentifier,
+	kHIToolbarFontsItemIdentifier
+};
+
+//-----------------------------------------------------------------------------
+//	FindToolbarCatalogEntry
+//-----------------------------------------------------------------------------
+//	Look up an item by identifier. The first time through we build a hash table
+//	of the catalog, so that finding an item doesn't get slower as the catalog
+//	grows. Returns NULL for identifiers we don't define (including the ones the
+//	Toolbox supplies).
+//
+const ToolbarCatalogEntry*
+FindToolbarCatalogEntry( CFStringRef inIdentifier )
+{
+	static CFDictionaryRef	sEntries = NULL;
+	
+	if ( sEntries == NULL )
+	{
+		CFMutableDictionaryRef	entries;
+		ItemCount				i;
+		
+		entries = CFDictionaryCreateMutable( NULL, kToolbarCatalogCount, &kCFTypeDictionaryKeyCallBacks, NULL );
+		require( entries != NULL, CantCreateEntries );
+		
+		for ( i = 0; i < kToolbarCatalogCount; i++ )
+			CFDictionaryAddValue( entries, kToolbarCatalog[ i ].identifier, &kToolbarCatalog[ i ] );
+		
+		// Two entries with the same identifier would mean one of them can
+		// never be created. Tests/ToolbarCatalogTests.c checks for that, and
+		// for hash collisions, before the catalog ships; this is a backstop
+		// in debug builds.
+		
+		check( (ItemCount)CFDictionaryGetCount( entries ) == kToolbarCatalogCount );
+		
+		sEntries = entries;
+	}
+	
+	return (const ToolbarCatalogEntry*)CFDictionaryGetValue( sEntries, inIdentifier );
+
+CantCreateEntries:
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarCatalogDefaultItems
+//-----------------------------------------------------------------------------
+//	The identifiers of our default toolbar. Every toolbar asks for the same
+//	defaults, so we build the array once and share it.
+//
+CFArrayRef
+GetToolbarCatalogDefaultItems()
+{
+	static CFArrayRef	sDefaultItems = NULL;
+	
+	if ( sDefaultItems == NULL )
+		sDefaultItems = CFArrayCreate( NULL, (const void**)kDefaultItems,
+				sizeof( kDefaultItems ) / sizeof( kDefaultItems[0] ), &kCFTypeArrayCallBacks );
+	
+	return sDefaultItems;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarCatalogAllowedItems
+//-----------------------------------------------------------------------------
+//	The identifiers shown in the configuration palette, in the order shown.
+//
+CFArrayRef
+GetToolbarCatalogAllowedItems()
+{
+	static CFArrayRef	sAllowedItems = NULL;
+	
+	if ( sAllowedItems == NULL )
+		sAllowedItems = CFArrayCreate( NULL, (const void**)kAllowedItems,
+				sizeof( kAllowedItems ) / sizeof( kAllowedItems[0] ), &kCFTypeArrayCallBacks );
+	
+	return sAllowedItems;
+}
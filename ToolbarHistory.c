@@ -0,0 +1,716 @@
+/*
+    File:		ToolbarHistory.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include "ToolbarHistory.h"
+#include "ToolbarMirror.h"
+#include "ToolbarStats.h"
+
+// Each window keeps a short history of its toolbar's configuration so that
+// customizations can be undone and redone. A snapshot is an immutable
+// property list dictionary holding the display mode, the display size, and
+// an array of item descriptors (identifier plus any config data). Since it
+// is a plain property list, a snapshot can also be written straight to
+// prefs. Descriptors that didn't change are shared with the previous
+// snapshot rather than copied, so a snapshot only costs one pointer per item.
+
+enum
+{
+	kMaxToolbarHistory		= 64
+};
+
+#define kToolbarHistoryCreator		'CTba'
+#define kToolbarHistoryTag			'Hist'
+
+#define kSnapshotItemsKey			kToolbarSnapshotItemsKey
+#define kSnapshotDisplayModeKey		CFSTR( "displayMode" )
+#define kSnapshotDisplaySizeKey		CFSTR( "displaySize" )
+#define kItemIdentifierKey			kToolbarItemIdentifierKey
+#define kItemConfigDataKey			kToolbarItemConfigDataKey
+
+struct ToolbarHistory
+{
+	WindowRef			window;
+	HIToolbarRef		toolbar;
+	EventHandlerRef		toolbarHandler;
+	CFDictionaryRef		snapshots[ kMaxToolbarHistory ];
+	ItemCount			first;			// ring index of the oldest snapshot
+	ItemCount			count;			// number of snapshots we hold
+	ItemCount			current;		// offset from first of the one showing
+	Boolean				restoring;
+	Boolean				mirroring;		// applying a change from another copy of the app
+};
+typedef struct ToolbarHistory ToolbarHistory;
+
+static const EventTypeSpec kToolbarChangeEvents[] =
+{
+	{ kEventClassToolbar, kEventToolbarLayoutChanged },
+	{ kEventClassToolbar, kEventToolbarDisplayModeChanged },
+	{ kEventClassToolbar, kEventToolbarDisplaySizeChanged }
+};
+
+static const EventTypeSpec kWindowEvents[] =
+{
+	{ kEventClassWindow, kEventWindowClosed }
+};
+
+static ToolbarHistory*	GetToolbarHistory( WindowRef inWindow );
+static CFDictionaryRef	GetSnapshotAt( ToolbarHistory* inHistory, ItemCount inOffset );
+static void				RecordToolbarSnapshot( ToolbarHistory* inHistory );
+static void				RestoreToolbarSnapshot( ToolbarHistory* inHistory, ItemCount inOffset );
+static Boolean			SameSnapshotItems( CFDictionaryRef inSnapshot, CFDictionaryRef inOther );
+static void				DisposeToolbarHistory( ToolbarHistory* inHistory );
+static SInt32			GetSnapshotStatsBytes( CFDictionaryRef inSnapshot );
+static void				ReleaseHistorySnapshot( CFDictionaryRef inSnapshot );
+static CFDictionaryRef	CreateToolbarSnapshot( HIToolbarRef inToolbar, CFDictionaryRef inPrevious );
+static OSStatus			ApplyToolbarSnapshot( HIToolbarRef inToolbar, CFDictionaryRef inSnapshot );
+static void				ApplyMirroredToolbarSnapshot( WindowRef inWindow, CFDictionaryRef inSnapshot );
+static CFTypeRef		CopyToolbarItemConfigData( HIToolbarItemRef inItem );
+static CFDictionaryRef	CreateItemDescriptor( HIToolbarItemRef inItem, CFSetRef inPrevious );
+static OSStatus			ToolbarChangeHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+static OSStatus			HistoryWindowHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+
+//-----------------------------------------------------------------------------
+//	InstallToolbarHistory
+//-----------------------------------------------------------------------------
+//	Start tracking changes to the toolbar attached to this window. The first
+//	snapshot is the toolbar as it is right now, and can't be undone past.
+//
+void
+InstallToolbarHistory( WindowRef inWindow )
+{
+	ToolbarHistory*		history;
+	HIToolbarRef		toolbar;
+	
+	require_noerr( GetWindowToolbar( inWindow, &toolbar ), CantGetToolbar );
+	
+	history = (ToolbarHistory*)calloc( 1, sizeof( ToolbarHistory ) );
+	require( history != NULL, CantAllocHistory );
+	
+	history->window = inWindow;
+	history->toolbar = toolbar;
+	RecordToolbarSnapshot( history );
+	
+	SetWindowProperty( inWindow, kToolbarHistoryCreator, kToolbarHistoryTag, sizeof( ToolbarHistory* ), &history );
+	
+	InstallEventHandler( HIObjectGetEventTarget( toolbar ), ToolbarChangeHandler,
+			GetEventTypeCount( kToolbarChangeEvents ), kToolbarChangeEvents, history,
+			&history->toolbarHandler );
+	InstallWindowEventHandler( inWindow, HistoryWindowHandler, GetEventTypeCount( kWindowEvents ),
+			kWindowEvents, history, NULL );
+
+CantAllocHistory:
+CantGetToolbar:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarCanUndo / ToolbarCanRedo
+//-----------------------------------------------------------------------------
+//	Used to enable and disable the Undo and Redo menu items.
+//
+Boolean
+ToolbarCanUndo( WindowRef inWindow )
+{
+	ToolbarHistory*		history = GetToolbarHistory( inWindow );
+	
+	return history != NULL && history->current > 0;
+}
+
+Boolean
+ToolbarCanRedo( WindowRef inWindow )
+{
+	ToolbarHistory*		history = GetToolbarHistory( inWindow );
+	
+	return history != NULL && history->current + 1 < history->count;
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarUndo / ToolbarRedo
+//-----------------------------------------------------------------------------
+//	Step backwards or forwards through the history. Stepping is just moving
+//	our current position; the toolbar is then brought in line with whatever
+//	snapshot we land on.
+//
+void
+ToolbarUndo( WindowRef inWindow )
+{
+	if ( ToolbarCanUndo( inWindow ) )
+	{
+		ToolbarHistory*		history = GetToolbarHistory( inWindow );
+		
+		RestoreToolbarSnapshot( history, history->current - 1 );
+	}
+}
+
+void
+ToolbarRedo( WindowRef inWindow )
+{
+	if ( ToolbarCanRedo( inWindow ) )
+	{
+		ToolbarHistory*		history = GetToolbarHistory( inWindow );
+		
+		RestoreToolbarSnapshot( history, history->current + 1 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	ApplyMirroredToolbarSnapshot
+//-----------------------------------------------------------------------------
+//	Another window, or another copy of the app, changed its toolbar. Apply
+//	the change here as a step of its own, so the user can undo it like any
+//	other, but don't send it back out.
+//
+static void
+ApplyMirroredToolbarSnapshot( WindowRef inWindow, CFDictionaryRef inSnapshot )
+{
+	ToolbarHistory*		history = GetToolbarHistory( inWindow );
+	HIToolbarRef		toolbar;
+	
+	if ( history == NULL )
+	{
+		if ( GetWindowToolbar( inWindow, &toolbar ) == noErr )
+			ApplyToolbarSnapshot( toolbar, inSnapshot );
+		return;
+	}
+	
+	history->restoring = true;
+	ApplyToolbarSnapshot( history->toolbar, inSnapshot );
+	history->restoring = false;
+	
+	history->mirroring = true;
+	RecordToolbarSnapshot( history );
+	history->mirroring = false;
+}
+
+//-----------------------------------------------------------------------------
+//	ShareToolbarItems
+//-----------------------------------------------------------------------------
+//	Every toolbar we have shows the same items, so a change to the items in
+//	one is applied to all the others, including the ones in windows we are
+//	keeping hidden for later. The display mode and size stay with each
+//	window, so only the items are passed on. inSource is the window the
+//	change was made in, which already has it, or NULL for a change from
+//	another copy of the app.
+//
+void
+ShareToolbarItems( WindowRef inSource, CFArrayRef inItems )
+{
+	const void*			keys[] = { kSnapshotItemsKey };
+	const void*			values[] = { inItems };
+	CFDictionaryRef		snapshot;
+	WindowRef			window;
+	
+	snapshot = CFDictionaryCreate( NULL, keys, values, 1,
+			&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	require( snapshot != NULL, CantCreateSnapshot );
+	
+	for ( window = GetFrontWindowOfClass( kDocumentWindowClass, false ); window != NULL;
+			window = GetNextWindowOfClass( window, kDocumentWindowClass, false ) )
+	{
+		HIToolbarRef	toolbar;
+		
+		if ( window != inSource && GetWindowToolbar( window, &toolbar ) == noErr && toolbar != NULL )
+			ApplyMirroredToolbarSnapshot( window, snapshot );
+	}
+	
+	CFRelease( snapshot );
+
+CantCreateSnapshot:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	ApplyToolbarSnapshot
+//-----------------------------------------------------------------------------
+//	Bring a toolbar in line with a snapshot. Items at the front of the toolbar
+//	that already match the snapshot are left alone; everything after the first
+//	difference is removed and recreated through the toolbar's delegate. We
+//	only describe the toolbar's items as far as that first difference, rather
+//	than snapshotting the whole toolbar up front, and each item is appended as
+//	soon as it is created.
+//
+static OSStatus
+ApplyToolbarSnapshot( HIToolbarRef inToolbar, CFDictionaryRef inSnapshot )
+{
+	OSStatus			err = noErr;
+	CFArrayRef			items, currentItems;
+	CFNumberRef			number;
+	CFIndex				i, count, currentCount, matching;
+	UInt32				value;
+	
+	number = (CFNumberRef)CFDictionaryGetValue( inSnapshot, kSnapshotDisplayModeKey );
+	if ( number && CFGetTypeID( number ) == CFNumberGetTypeID()
+			&& CFNumberGetValue( number, kCFNumberSInt32Type, &value ) )
+		HIToolbarSetDisplayMode( inToolbar, value );
+	
+	number = (CFNumberRef)CFDictionaryGetValue( inSnapshot, kSnapshotDisplaySizeKey );
+	if ( number && CFGetTypeID( number ) == CFNumberGetTypeID()
+			&& CFNumberGetValue( number, kCFNumberSInt32Type, &value ) )
+		HIToolbarSetDisplaySize( inToolbar, value );
+	
+	items = (CFArrayRef)CFDictionaryGetValue( inSnapshot, kSnapshotItemsKey );
+	require_action( items != NULL && CFGetTypeID( items ) == CFArrayGetTypeID(), NoItems, err = paramErr );
+	
+	err = HIToolbarCopyItems( inToolbar, &currentItems );
+	require_noerr( err, CantCopyItems );
+	
+	currentCount = CFArrayGetCount( currentItems );
+	count = CFArrayGetCount( items );
+	
+	for ( matching = 0; matching < count && matching < currentCount; matching++ )
+	{
+		CFDictionaryRef		descriptor;
+		Boolean				equal;
+		
+		descriptor = CreateItemDescriptor( (HIToolbarItemRef)CFArrayGetValueAtIndex( currentItems, matching ), NULL );
+		equal = descriptor != NULL && CFEqual( descriptor, CFArrayGetValueAtIndex( items, matching ) );
+		if ( descriptor )
+			CFRelease( descriptor );
+		
+		if ( !equal )
+			break;
+	}
+	
+	CFRelease( currentItems );
+	
+	for ( i = currentCount - 1; i >= matching; i-- )
+		HIToolbarRemoveItemAtIndex( inToolbar, i );
+	
+	for ( i = matching; i < count; i++ )
+	{
+		CFDictionaryRef		descriptor = (CFDictionaryRef)CFArrayGetValueAtIndex( items, i );
+		CFTypeRef			identifier;
+		HIToolbarItemRef	item;
+		
+		// Snapshots can come from another process, so a descriptor without
+		// a string identifier is skipped rather than handed to the toolbox.
+		
+		if ( CFGetTypeID( descriptor ) != CFDictionaryGetTypeID() )
+			continue;
+		identifier = CFDictionaryGetValue( descriptor, kItemIdentifierKey );
+		if ( identifier == NULL || CFGetTypeID( identifier ) != CFStringGetTypeID() )
+			continue;
+		
+		if ( HIToolbarCreateItemWithIdentifier( inToolbar, (CFStringRef)identifier,
+				CFDictionaryGetValue( descriptor, kItemConfigDataKey ), &item ) == noErr )
+		{
+			HIToolbarAppendItem( inToolbar, item );
+			CFRelease( item );
+		}
+	}
+	
+CantCopyItems:
+NoItems:
+	return err;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarHistory
+//-----------------------------------------------------------------------------
+//
+static ToolbarHistory*
+GetToolbarHistory( WindowRef inWindow )
+{
+	ToolbarHistory*		history = NULL;
+	
+	if ( GetWindowProperty( inWindow, kToolbarHistoryCreator, kToolbarHistoryTag,
+			sizeof( ToolbarHistory* ), NULL, &history ) != noErr )
+		history = NULL;
+	
+	return history;
+}
+
+//-----------------------------------------------------------------------------
+//	GetSnapshotAt
+//-----------------------------------------------------------------------------
+//	Our snapshots live in a ring so that dropping the oldest one when the
+//	history is full doesn't mean shuffling the rest down.
+//
+static CFDictionaryRef
+GetSnapshotAt( ToolbarHistory* inHistory, ItemCount inOffset )
+{
+	return inHistory->snapshots[ ( inHistory->first + inOffset ) % kMaxToolbarHistory ];
+}
+
+//-----------------------------------------------------------------------------
+//	RecordToolbarSnapshot
+//-----------------------------------------------------------------------------
+//	Called whenever the toolbar tells us it changed. If the toolbar really is
+//	different from what we have, we throw away anything that could have been
+//	redone and push the new state. When the history is full, the oldest state
+//	falls off the end. Changes the user made to the items are passed on to
+//	our other windows and to the other copies of the app; display mode and
+//	size are ours alone, so changes to those stay here.
+//
+static void
+RecordToolbarSnapshot( ToolbarHistory* inHistory )
+{
+	CFDictionaryRef		current = NULL;
+	CFDictionaryRef		snapshot;
+	ItemCount			i;
+	Boolean				publish;
+	
+	if ( inHistory->count > 0 )
+		current = GetSnapshotAt( inHistory, inHistory->current );
+	
+	snapshot = CreateToolbarSnapshot( inHistory->toolbar, current );
+	require( snapshot != NULL, CantSnapshot );
+	
+	if ( current != NULL && CFEqual( current, snapshot ) )
+	{
+		CFRelease( snapshot );
+		return;
+	}
+	
+	// Our very first snapshot is just the toolbar as we found it, not a change.
+	
+	publish = ( current != NULL && !inHistory->mirroring && !SameSnapshotItems( current, snapshot ) );
+	
+	// If all we have is an empty toolbar, the toolbar hadn't been populated
+	// from prefs yet when we started, and there's nothing worth undoing to.
+	// Filling it from prefs isn't a change worth telling anybody about either.
+	
+	if ( inHistory->count == 1 && CFArrayGetCount(
+			(CFArrayRef)CFDictionaryGetValue( current, kSnapshotItemsKey ) ) == 0 )
+	{
+		ReleaseHistorySnapshot( current );
+		inHistory->count = 0;
+		inHistory->current = 0;
+		publish = false;
+	}
+	
+	if ( inHistory->count > 0 )
+	{
+		for ( i = inHistory->current + 1; i < inHistory->count; i++ )
+			ReleaseHistorySnapshot( GetSnapshotAt( inHistory, i ) );
+		
+		inHistory->count = inHistory->current + 1;
+	}
+	
+	if ( inHistory->count == kMaxToolbarHistory )
+	{
+		ReleaseHistorySnapshot( inHistory->snapshots[ inHistory->first ] );
+		inHistory->first = ( inHistory->first + 1 ) % kMaxToolbarHistory;
+		inHistory->count--;
+	}
+	
+	inHistory->snapshots[ ( inHistory->first + inHistory->count ) % kMaxToolbarHistory ] = snapshot;
+	inHistory->current = inHistory->count++;
+	
+	ToolbarStatsAdd( kToolbarStatsSnapshots, 1, GetSnapshotStatsBytes( snapshot ) );
+	
+	if ( publish )
+	{
+		PublishToolbarConfig( snapshot );
+		ShareToolbarItems( inHistory->window, (CFArrayRef)CFDictionaryGetValue( snapshot, kSnapshotItemsKey ) );
+	}
+
+CantSnapshot:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	RestoreToolbarSnapshot
+//-----------------------------------------------------------------------------
+//	Move to a different point in our history. We ignore the change events the
+//	toolbar sends while we rebuild it, since those changes are our own doing.
+//	Undoing a change to the items is still a change as far as our other
+//	windows and the other copies of the app are concerned, so we pass it on.
+//
+static void
+RestoreToolbarSnapshot( ToolbarHistory* inHistory, ItemCount inOffset )
+{
+	CFDictionaryRef		snapshot = GetSnapshotAt( inHistory, inOffset );
+	Boolean				publish = !SameSnapshotItems( GetSnapshotAt( inHistory, inHistory->current ), snapshot );
+	
+	inHistory->restoring = true;
+	ApplyToolbarSnapshot( inHistory->toolbar, snapshot );
+	inHistory->restoring = false;
+	
+	inHistory->current = inOffset;
+	
+	if ( publish )
+	{
+		PublishToolbarConfig( snapshot );
+		ShareToolbarItems( inHistory->window, (CFArrayRef)CFDictionaryGetValue( snapshot, kSnapshotItemsKey ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	SameSnapshotItems
+//-----------------------------------------------------------------------------
+//	Whether two snapshots differ only in display mode or size.
+//
+static Boolean
+SameSnapshotItems( CFDictionaryRef inSnapshot, CFDictionaryRef inOther )
+{
+	return CFEqual( CFDictionaryGetValue( inSnapshot, kSnapshotItemsKey ),
+			CFDictionaryGetValue( inOther, kSnapshotItemsKey ) );
+}
+
+//-----------------------------------------------------------------------------
+//	DisposeToolbarHistory
+//-----------------------------------------------------------------------------
+//	Something else may still hold on to the toolbar after its window is gone,
+//	so we take our handler off it, and our property off the window, before
+//	the history goes away.
+//
+static void
+DisposeToolbarHistory( ToolbarHistory* inHistory )
+{
+	ItemCount		i;
+	
+	if ( inHistory->toolbarHandler )
+		RemoveEventHandler( inHistory->toolbarHandler );
+	RemoveWindowProperty( inHistory->window, kToolbarHistoryCreator, kToolbarHistoryTag );
+	
+	for ( i = 0; i < inHistory->count; i++ )
+		ReleaseHistorySnapshot( GetSnapshotAt( inHistory, i ) );
+	
+	free( inHistory );
+}
+
+//-----------------------------------------------------------------------------
+//	ReleaseHistorySnapshot
+//-----------------------------------------------------------------------------
+//	Let go of a snapshot we were holding in a history.
+//
+static void
+ReleaseHistorySnapshot( CFDictionaryRef inSnapshot )
+{
+	ToolbarStatsAdd( kToolbarStatsSnapshots, -1, -GetSnapshotStatsBytes( inSnapshot ) );
+	CFRelease( inSnapshot );
+}
+
+//-----------------------------------------------------------------------------
+//	GetSnapshotStatsBytes
+//-----------------------------------------------------------------------------
+//	What a snapshot costs us, for our memory stats. Item descriptors are mostly
+//	shared between snapshots, so we only count the slot each item takes.
+//
+static SInt32
+GetSnapshotStatsBytes( CFDictionaryRef inSnapshot )
+{
+	CFArrayRef		items = (CFArrayRef)CFDictionaryGetValue( inSnapshot, kSnapshotItemsKey );
+	
+	return CFArrayGetCount( items ) * sizeof( void* );
+}
+
+//-----------------------------------------------------------------------------
+//	CreateToolbarSnapshot
+//-----------------------------------------------------------------------------
+//	Build a snapshot of the toolbar. If we are given the previous snapshot,
+//	any item descriptor that is unchanged is shared with it instead of being
+//	kept twice.
+//
+static CFDictionaryRef
+CreateToolbarSnapshot( HIToolbarRef inToolbar, CFDictionaryRef inPrevious )
+{
+	CFDictionaryRef			result = NULL;
+	CFArrayRef				items;
+	CFMutableArrayRef		descriptors;
+	CFSetRef				previous = NULL;
+	CFIndex					i, count;
+	HIToolbarDisplayMode	mode;
+	HIToolbarDisplaySize	size;
+	CFNumberRef				modeNumber, sizeNumber;
+	
+	require_noerr( HIToolbarCopyItems( inToolbar, &items ), CantCopyItems );
+	
+	count = CFArrayGetCount( items );
+	descriptors = CFArrayCreateMutable( NULL, count, &kCFTypeArrayCallBacks );
+	require( descriptors != NULL, CantCreateArray );
+	
+	if ( inPrevious != NULL )
+	{
+		CFArrayRef		previousItems = (CFArrayRef)CFDictionaryGetValue( inPrevious, kSnapshotItemsKey );
+		CFIndex			previousCount = CFArrayGetCount( previousItems );
+		const void**	values = (const void**)malloc( previousCount * sizeof( void* ) );
+		
+		if ( values != NULL )
+		{
+			CFArrayGetValues( previousItems, CFRangeMake( 0, previousCount ), values );
+			previous = CFSetCreate( NULL, values, previousCount, &kCFTypeSetCallBacks );
+			free( values );
+		}
+	}
+	
+	for ( i = 0; i < count; i++ )
+	{
+		CFDictionaryRef		descriptor;
+		
+		descriptor = CreateItemDescriptor( (HIToolbarItemRef)CFArrayGetValueAtIndex( items, i ), previous );
+		if ( descriptor )
+		{
+			CFArrayAppendValue( descriptors, descriptor );
+			CFRelease( descriptor );
+		}
+	}
+	
+	HIToolbarGetDisplayMode( inToolbar, &mode );
+	HIToolbarGetDisplaySize( inToolbar, &size );
+	modeNumber = CFNumberCreate( NULL, kCFNumberSInt32Type, &mode );
+	sizeNumber = CFNumberCreate( NULL, kCFNumberSInt32Type, &size );
+	
+	{
+		const void*		keys[] = { kSnapshotItemsKey, kSnapshotDisplayModeKey, kSnapshotDisplaySizeKey };
+		const void*		values[] = { descriptors, modeNumber, sizeNumber };
+		
+		result = CFDictionaryCreate( NULL, keys, values, 3,
+				&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	}
+	
+	CFRelease( modeNumber );
+	CFRelease( sizeNumber );
+	if ( previous )
+		CFRelease( previous );
+	CFRelease( descriptors );
+
+CantCreateArray:
+	CFRelease( items );
+
+CantCopyItems:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	CreateItemDescriptor
+//-----------------------------------------------------------------------------
+//	Describe one item by its identifier and whatever config data it wants
+//	saved. If an equal descriptor is in the previous snapshot, we return that
+//	one (retained) instead.
+//
+static CFDictionaryRef
+CreateItemDescriptor( HIToolbarItemRef inItem, CFSetRef inPrevious )
+{
+	CFDictionaryRef		result = NULL;
+	CFStringRef			identifier;
+	CFTypeRef			data;
+	const void*			keys[] = { kItemIdentifierKey, kItemConfigDataKey };
+	const void*			values[ 2 ];
+	
+	require_noerr( HIToolbarItemCopyIdentifier( inItem, &identifier ), CantGetIdentifier );
+	
+	data = CopyToolbarItemConfigData( inItem );
+	
+	values[0] = identifier;
+	values[1] = data;
+	
+	result = CFDictionaryCreate( NULL, keys, values, data ? 2 : 1,
+			&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	
+	if ( result != NULL && inPrevious != NULL )
+	{
+		CFDictionaryRef		existing = (CFDictionaryRef)CFSetGetValue( inPrevious, result );
+		
+		if ( existing )
+		{
+			CFRelease( result );
+			result = (CFDictionaryRef)CFRetain( existing );
+		}
+	}
+	
+	if ( data )
+		CFRelease( data );
+	CFRelease( identifier );
+
+CantGetIdentifier:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	CopyToolbarItemConfigData
+//-----------------------------------------------------------------------------
+//	Ask an item for the data it would save to prefs. This is the same event
+//	the toolbar sends when it writes its config.
+//
+static CFTypeRef
+CopyToolbarItemConfigData( HIToolbarItemRef inItem )
+{
+	EventRef		event;
+	CFTypeRef		result = NULL;
+	
+	if ( CreateEvent( NULL, kEventClassToolbarItem, kEventToolbarItemGetPersistentData,
+			GetCurrentEventTime(), 0, &event ) == noErr )
+	{
+		if ( SendEventToEventTarget( event, HIObjectGetEventTarget( inItem ) ) == noErr )
+		{
+			if ( GetEventParameter( event, kEventParamToolbarItemConfigData, typeCFTypeRef, NULL,
+					sizeof( CFTypeRef ), NULL, &result ) != noErr )
+				result = NULL;
+		}
+		ReleaseEvent( event );
+	}
+	
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarChangeHandler
+//-----------------------------------------------------------------------------
+//	The toolbar changed its layout, display mode or size. Note it down. We
+//	never handle these events, since others may want to see them too.
+//
+static OSStatus
+ToolbarChangeHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
+{
+	ToolbarHistory*		history = (ToolbarHistory*)inUserData;
+	
+	if ( !history->restoring )
+		RecordToolbarSnapshot( history );
+	
+	return eventNotHandledErr;
+}
+
+//-----------------------------------------------------------------------------
+//	HistoryWindowHandler
+//-----------------------------------------------------------------------------
+//	Clean up our history when the window goes away.
+//
+static OSStatus
+HistoryWindowHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
+{
+	DisposeToolbarHistory( (ToolbarHistory*)inUserData );
+	
+	return eventNotHandledErr;
+}
@@ -0,0 +1,294 @@
+/*
+    File:		ToolbarIcons.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include "ToolbarIcons.h"
+#include "ToolbarStats.h"
+
+// Our item icons, drawn ahead of time at each size the toolbar shows them
+// at. Left to itself, the toolbar draws an item's IconRef at whatever size
+// it needs every time it draws, scaling from whichever representation the
+// icon happens to have. Instead we draw each icon once per size, with high
+// quality interpolation, and give the items the finished images. Switching
+// the toolbar between regular and small size then only hands each item a
+// different image.
+//
+// We let Icon Services do the drawing, since it picks the representation
+// closest to the size we ask for; a hand-drawn 32 pixel icon is better than
+// anything we could scale down from the 128 pixel one.
+//
+// Icons are drawn in batches. Each batch gets one bitmap (a page) per size,
+// with its icons side by side, and the image an item gets is just a
+// rectangle of the page. The whole page is drawn before any image is made
+// from it, and never drawn into again, since Quartz expects an image's data
+// not to change. Our catalog icons are all drawn as one batch at idle time,
+// so normally there is one block of pixels per size rather than one per
+// icon per size. An icon that is asked for before then gets a batch (and
+// pages) of its own.
+
+enum
+{
+	kToolbarIconLevelRegular	= 0,
+	kToolbarIconLevelSmall		= 1,
+	kToolbarIconLevelCount		= 2
+};
+
+enum
+{
+	kMaxToolbarIcons			= 16
+};
+
+static const size_t kLevelSizes[ kToolbarIconLevelCount ] = { 32, 24 };
+
+struct IconPyramid
+{
+	IconRef			icon;
+	CGImageRef		levels[ kToolbarIconLevelCount ];
+};
+typedef struct IconPyramid IconPyramid;
+
+static IconPyramid		sPyramids[ kMaxToolbarIcons ];
+static ItemCount		sPyramidCount;
+
+static IconPyramid*		FindIconPyramid( IconRef inIcon );
+static Boolean			CreateIconPage( UInt32 inLevel, const IconRef* inIcons, ItemCount inCount,
+								CGImageRef* outImages );
+
+//-----------------------------------------------------------------------------
+//	PrepareToolbarIconImages
+//-----------------------------------------------------------------------------
+//	Draw a batch of icons at every size, sharing one page per size. Icons we
+//	have already drawn are skipped. Once we have drawn as many icons as we
+//	keep, the rest are left for the toolbar to draw from their IconRefs.
+//
+void
+PrepareToolbarIconImages( const IconRef* inIcons, ItemCount inCount )
+{
+	IconRef			icons[ kMaxToolbarIcons ];
+	CGImageRef		images[ kToolbarIconLevelCount ][ kMaxToolbarIcons ];
+	ItemCount		i, j, count = 0;
+	UInt32			level;
+	
+	for ( i = 0; i < inCount && sPyramidCount + count < kMaxToolbarIcons; i++ )
+	{
+		if ( inIcons[ i ] == NULL || FindIconPyramid( inIcons[ i ] ) != NULL )
+			continue;
+		
+		for ( j = 0; j < count && icons[ j ] != inIcons[ i ]; j++ )
+			;
+		if ( j == count )
+			icons[ count++ ] = inIcons[ i ];
+	}
+	
+	require_quiet( count > 0, NothingToDraw );
+	
+	for ( level = 0; level < kToolbarIconLevelCount; level++ )
+	{
+		require( CreateIconPage( level, icons, count, images[ level ] ), CantCreatePage );
+	}
+	
+	// We hold onto the icons, so that their IconRefs can't be reused for
+	// other icons while we still have images filed under them.
+	
+	for ( i = 0; i < count; i++ )
+	{
+		IconPyramid*	pyramid = &sPyramids[ sPyramidCount++ ];
+		
+		AcquireIconRef( icons[ i ] );
+		pyramid->icon = icons[ i ];
+		for ( level = 0; level < kToolbarIconLevelCount; level++ )
+			pyramid->levels[ level ] = images[ level ][ i ];
+	}
+	
+	return;
+
+CantCreatePage:
+	while ( level-- > 0 )
+	{
+		for ( i = 0; i < count; i++ )
+			CGImageRelease( images[ level ][ i ] );
+		ToolbarStatsAdd( kToolbarStatsIcons, 0,
+				-(SInt32)( count * kLevelSizes[ level ] * kLevelSizes[ level ] * 4 ) );
+	}
+
+NothingToDraw:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarIconImage
+//-----------------------------------------------------------------------------
+//	The image to use for an icon when the toolbar is at the given size. If we
+//	haven't drawn the icon yet, we draw it now, in a batch of its own. The
+//	items retain the image themselves, so the caller doesn't need to release
+//	it. Returns NULL if the icon couldn't be drawn, in which case the item
+//	should just be given the IconRef.
+//
+CGImageRef
+GetToolbarIconImage( IconRef inIcon, HIToolbarDisplaySize inSize )
+{
+	IconPyramid*	pyramid;
+	
+	require( inIcon != NULL, NoIcon );
+	
+	pyramid = FindIconPyramid( inIcon );
+	if ( pyramid == NULL )
+	{
+		PrepareToolbarIconImages( &inIcon, 1 );
+		pyramid = FindIconPyramid( inIcon );
+	}
+	require( pyramid != NULL, NoIcon );
+	
+	return pyramid->levels[ ( inSize == kHIToolbarDisplaySizeSmall ) ? kToolbarIconLevelSmall
+			: kToolbarIconLevelRegular ];
+
+NoIcon:
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	FindIconPyramid
+//-----------------------------------------------------------------------------
+//	Find the images we drew for this icon, if we have.
+//
+static IconPyramid*
+FindIconPyramid( IconRef inIcon )
+{
+	ItemCount		i;
+	
+	for ( i = 0; i < sPyramidCount; i++ )
+	{
+		if ( sPyramids[ i ].icon == inIcon )
+			return &sPyramids[ i ];
+	}
+	
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	CreateIconPage
+//-----------------------------------------------------------------------------
+//	Draw a row of icons at one size into a new page, and make an image of each
+//	icon's rectangle of it. The images share the page's pixels rather than
+//	copying them; the page goes away when the last of them does. If any icon
+//	fails to draw, we make no images at all.
+//
+static Boolean
+CreateIconPage( UInt32 inLevel, const IconRef* inIcons, ItemCount inCount, CGImageRef* outImages )
+{
+	size_t				size = kLevelSizes[ inLevel ];
+	size_t				rowBytes = inCount * size * 4;
+	CFMutableDataRef	bits;
+	CGColorSpaceRef		colorSpace;
+	CGContextRef		context;
+	CGDataProviderRef	provider;
+	CGImageRef			page;
+	ItemCount			i;
+	OSStatus			err = noErr;
+	Boolean				result = false;
+	
+	bits = CFDataCreateMutable( NULL, rowBytes * size );
+	require( bits != NULL, CantCreateBits );
+	CFDataSetLength( bits, rowBytes * size );
+	
+	colorSpace = CGColorSpaceCreateWithName( kCGColorSpaceGenericRGB );
+	require( colorSpace != NULL, CantCreateColorSpace );
+	
+	context = CGBitmapContextCreate( CFDataGetMutableBytePtr( bits ), inCount * size, size, 8,
+			rowBytes, colorSpace, kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Host );
+	require( context != NULL, CantCreateContext );
+	
+	CGContextSetInterpolationQuality( context, kCGInterpolationHigh );
+	
+	for ( i = 0; i < inCount && err == noErr; i++ )
+	{
+		CGRect		bounds = CGRectMake( i * size, 0, size, size );
+		
+		err = PlotIconRefInContext( context, &bounds, kAlignNone, kTransformNone, NULL,
+				kPlotIconRefNormalFlags, inIcons[ i ] );
+	}
+	
+	// That's all the drawing this page will ever get, so now it can become
+	// an image.
+	
+	CGContextRelease( context );
+	require_noerr( err, CantPlotIcon );
+	
+	provider = CGDataProviderCreateWithCFData( bits );
+	require( provider != NULL, CantCreateProvider );
+	
+	page = CGImageCreate( inCount * size, size, 8, 32, rowBytes, colorSpace,
+			kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Host, provider, NULL,
+			false, kCGRenderingIntentDefault );
+	CGDataProviderRelease( provider );
+	require( page != NULL, CantCreatePage );
+	
+	for ( i = 0; i < inCount; i++ )
+	{
+		outImages[ i ] = CGImageCreateWithImageInRect( page, CGRectMake( i * size, 0, size, size ) );
+		if ( outImages[ i ] == NULL )
+			break;
+	}
+	
+	result = ( i == inCount );
+	if ( result )
+		ToolbarStatsAdd( kToolbarStatsIcons, 0, rowBytes * size );
+	else
+	{
+		while ( i-- > 0 )
+			CGImageRelease( outImages[ i ] );
+	}
+	
+	CGImageRelease( page );
+
+CantCreatePage:
+CantCreateProvider:
+CantPlotIcon:
+CantCreateContext:
+	CGColorSpaceRelease( colorSpace );
+
+CantCreateColorSpace:
+	CFRelease( bits );
+
+CantCreateBits:
+	return result;
+}
@@ -0,0 +1,582 @@
+/*
+    File:		ToolbarMirror.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include <unistd.h>
+
+#include "ToolbarMirror.h"
+#include "ToolbarHistory.h"
+#include "ToolbarStats.h"
+
+// Keeps the toolbars of every running copy of the app in step. Within a copy,
+// every window already shows the same items (see ShareToolbarItems); this
+// extends that to the other copies. When the user changes the items in a
+// toolbar, we send the new item list to the other copies with a distributed
+// notification, and they apply it exactly as they would a change made in one
+// of their own windows. Only the items are shared; display mode and size
+// stay with each window.
+//
+// Each update carries a generation (the time it was made). An update older
+// than the last one we sent or applied is dropped, so updates that cross in
+// flight settle on the newest rather than flip-flopping.
+//
+// Most changes only touch one or two items, so rather than the whole item
+// list we normally send just the edits against the previous generation: the
+// new order of the items, where an item we already had is sent as its index
+// in the old list, and only new or changed items are sent in full. Items are
+// matched by content (the hash and equality of their descriptors), so a move
+// costs a number, not a copy of the item. A copy that doesn't have the
+// previous generation (because it started late, or was in the background and
+// only got the last of several updates) asks for a resync, and the others
+// answer with their full item list.
+
+#define kToolbarMirrorNotification		CFSTR( "com.apple.carbontoolbar.ConfigChanged" )
+#define kToolbarMirrorResyncNotification	CFSTR( "com.apple.carbontoolbar.ConfigResync" )
+#define kToolbarMirrorObject			CFSTR( "com.apple.carbontoolbar" )
+
+#define kMirrorProcessKey				CFSTR( "pid" )
+#define kMirrorGenerationKey			CFSTR( "generation" )
+#define kMirrorItemsKey					kToolbarSnapshotItemsKey
+#define kMirrorBaseKey					CFSTR( "base" )
+#define kMirrorEditsKey					CFSTR( "edits" )
+
+static CFAbsoluteTime		sLastGeneration;
+static CFArrayRef			sLastItems;			// the items as of sLastGeneration
+static ToolbarMirrorStats	sStats;
+
+static void				ToolbarMirrorCallback( CFNotificationCenterRef inCenter, void* inObserver,
+								CFStringRef inName, const void* inObject, CFDictionaryRef inUserInfo );
+static void				ToolbarResyncCallback( CFNotificationCenterRef inCenter, void* inObserver,
+								CFStringRef inName, const void* inObject, CFDictionaryRef inUserInfo );
+static CFDictionaryRef	CreateMirrorUpdate( CFArrayRef inItems, CFArrayRef inEdits, CFAbsoluteTime inBase );
+static CFArrayRef		CreateItemEdits( CFArrayRef inBase, CFArrayRef inItems );
+static CFArrayRef		CreateItemsFromEdits( CFArrayRef inBase, CFArrayRef inEdits );
+static void				SetLastItems( CFArrayRef inItems );
+static CFDictionaryRef	CopyMirrorStatsSection();
+static void				NoteMirrorUpdate( CFDictionaryRef inUpdate, CFArrayRef inItems, Boolean inDelta, EventTime inElapsed );
+static CFIndex			GetPropertyListSize( CFPropertyListRef inPlist );
+static Boolean			GetUpdateNumber( CFDictionaryRef inUpdate, CFStringRef inKey, CFNumberType inType, void* outValue );
+static Boolean			IsValidItemDescriptor( CFTypeRef inDescriptor );
+static Boolean			AreValidItems( CFArrayRef inItems );
+
+//-----------------------------------------------------------------------------
+//	InstallToolbarMirror
+//-----------------------------------------------------------------------------
+//	Start listening for changes made by other copies of the app. If we are in
+//	the background, updates are coalesced until we come forward, so only the
+//	last one gets applied.
+//
+void
+InstallToolbarMirror()
+{
+	CFNotificationCenterAddObserver( CFNotificationCenterGetDistributedCenter(), NULL,
+			ToolbarMirrorCallback, kToolbarMirrorNotification, kToolbarMirrorObject,
+			CFNotificationSuspensionBehaviorCoalesce );
+	CFNotificationCenterAddObserver( CFNotificationCenterGetDistributedCenter(), NULL,
+			ToolbarResyncCallback, kToolbarMirrorResyncNotification, kToolbarMirrorObject,
+			CFNotificationSuspensionBehaviorCoalesce );
+	
+	InstallToolbarStatsSection( CFSTR( "mirror" ), CopyMirrorStatsSection );
+}
+
+//-----------------------------------------------------------------------------
+//	PublishToolbarConfig
+//-----------------------------------------------------------------------------
+//	Tell the other copies of the app about a new toolbar configuration.
+//
+void
+PublishToolbarConfig( CFDictionaryRef inSnapshot )
+{
+	CFArrayRef			items = (CFArrayRef)CFDictionaryGetValue( inSnapshot, kToolbarSnapshotItemsKey );
+	CFArrayRef			edits = NULL;
+	CFAbsoluteTime		base = sLastGeneration;
+	EventTime			start = GetCurrentEventTime();
+	CFDictionaryRef		userInfo;
+	
+	require( items != NULL, NoItems );
+	
+	if ( sLastItems != NULL )
+		edits = CreateItemEdits( sLastItems, items );
+	
+	sLastGeneration = CFAbsoluteTimeGetCurrent();
+	
+	userInfo = CreateMirrorUpdate( edits ? NULL : items, edits, base );
+	if ( userInfo )
+	{
+		CFNotificationCenterPostNotification( CFNotificationCenterGetDistributedCenter(),
+				kToolbarMirrorNotification, kToolbarMirrorObject, userInfo, true );
+		NoteMirrorUpdate( userInfo, items, edits != NULL, GetCurrentEventTime() - start );
+		CFRelease( userInfo );
+	}
+	
+	if ( edits )
+		CFRelease( edits );
+	
+	SetLastItems( items );
+
+NoItems:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarMirrorStats
+//-----------------------------------------------------------------------------
+//
+void
+GetToolbarMirrorStats( ToolbarMirrorStats* outStats )
+{
+	*outStats = sStats;
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarMirrorCallback
+//-----------------------------------------------------------------------------
+//	Another copy of the app (or, since distributed notifications go to
+//	everyone, possibly us) changed its toolbar. Any process can post this
+//	notification, so nothing in it is trusted: an update with a field of the
+//	wrong type, or an item we couldn't create, is dropped as a whole, since
+//	applying part of it would leave later edits pointing at the wrong items.
+//
+static void
+ToolbarMirrorCallback( CFNotificationCenterRef inCenter, void* inObserver,
+		CFStringRef inName, const void* inObject, CFDictionaryRef inUserInfo )
+{
+	SInt32			pid;
+	CFAbsoluteTime	generation, base;
+	CFArrayRef		items, edits;
+	
+	require( inUserInfo != NULL && CFGetTypeID( inUserInfo ) == CFDictionaryGetTypeID(), BadUpdate );
+	
+	require( GetUpdateNumber( inUserInfo, kMirrorProcessKey, kCFNumberSInt32Type, &pid ), BadUpdate );
+	require_quiet( pid != getpid(), OurOwnUpdate );
+	
+	require( GetUpdateNumber( inUserInfo, kMirrorGenerationKey, kCFNumberDoubleType, &generation ), BadUpdate );
+	require_quiet( generation > sLastGeneration, StaleUpdate );
+	
+	items = (CFArrayRef)CFDictionaryGetValue( inUserInfo, kMirrorItemsKey );
+	if ( items != NULL )
+	{
+		require( CFGetTypeID( items ) == CFArrayGetTypeID() && AreValidItems( items ), BadUpdate );
+		CFRetain( items );
+	}
+	else
+	{
+		// Just the edits. We can only use them if we have what they were
+		// made against; otherwise we ask for everything.
+		
+		edits = (CFArrayRef)CFDictionaryGetValue( inUserInfo, kMirrorEditsKey );
+		require( edits != NULL && CFGetTypeID( edits ) == CFArrayGetTypeID(), BadUpdate );
+		
+		require( GetUpdateNumber( inUserInfo, kMirrorBaseKey, kCFNumberDoubleType, &base ), BadUpdate );
+		
+		require_quiet( sLastItems != NULL && base == sLastGeneration, MissedUpdate );
+		
+		items = CreateItemsFromEdits( sLastItems, edits );
+		require( items != NULL, BadUpdate );
+	}
+	
+	sLastGeneration = generation;
+	SetLastItems( items );
+	ShareToolbarItems( NULL, items );
+	CFRelease( items );
+	return;
+
+MissedUpdate:
+	{
+		const void*			keys[] = { kMirrorProcessKey };
+		const void*			values[ 1 ];
+		CFDictionaryRef		request;
+		
+		pid = getpid();
+		values[0] = CFNumberCreate( NULL, kCFNumberSInt32Type, &pid );
+		request = CFDictionaryCreate( NULL, keys, values, 1,
+				&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+		CFRelease( values[0] );
+		
+		if ( request )
+		{
+			CFNotificationCenterPostNotification( CFNotificationCenterGetDistributedCenter(),
+					kToolbarMirrorResyncNotification, kToolbarMirrorObject, request, true );
+			CFRelease( request );
+		}
+	}
+
+StaleUpdate:
+OurOwnUpdate:
+BadUpdate:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarResyncCallback
+//-----------------------------------------------------------------------------
+//	Another copy of the app missed an update. Send it our full item list. We
+//	don't make a new generation for it, so copies that are already up to date
+//	drop it as stale, and if several of us answer, the newest list wins.
+//
+static void
+ToolbarResyncCallback( CFNotificationCenterRef inCenter, void* inObserver,
+		CFStringRef inName, const void* inObject, CFDictionaryRef inUserInfo )
+{
+	CFDictionaryRef		userInfo;
+	EventTime			start = GetCurrentEventTime();
+	SInt32				pid;
+	
+	require_quiet( sLastItems != NULL, NothingToSend );
+	
+	require( inUserInfo != NULL && CFGetTypeID( inUserInfo ) == CFDictionaryGetTypeID(), NothingToSend );
+	require( GetUpdateNumber( inUserInfo, kMirrorProcessKey, kCFNumberSInt32Type, &pid ), NothingToSend );
+	require_quiet( pid != getpid(), NothingToSend );
+	
+	userInfo = CreateMirrorUpdate( sLastItems, NULL, 0 );
+	if ( userInfo )
+	{
+		CFNotificationCenterPostNotification( CFNotificationCenterGetDistributedCenter(),
+				kToolbarMirrorNotification, kToolbarMirrorObject, userInfo, true );
+		NoteMirrorUpdate( userInfo, sLastItems, false, GetCurrentEventTime() - start );
+		sStats.resyncs++;
+		CFRelease( userInfo );
+	}
+
+NothingToSend:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	CreateMirrorUpdate
+//-----------------------------------------------------------------------------
+//	The user info for an update of the current generation. It holds either
+//	the full item list, or the edits against the base generation.
+//
+static CFDictionaryRef
+CreateMirrorUpdate( CFArrayRef inItems, CFArrayRef inEdits, CFAbsoluteTime inBase )
+{
+	CFMutableDictionaryRef	result;
+	SInt32					pid = getpid();
+	CFNumberRef				number;
+	
+	result = CFDictionaryCreateMutable( NULL, 4, &kCFTypeDictionaryKeyCallBacks,
+			&kCFTypeDictionaryValueCallBacks );
+	require( result != NULL, CantCreateUpdate );
+	
+	number = CFNumberCreate( NULL, kCFNumberSInt32Type, &pid );
+	CFDictionarySetValue( result, kMirrorProcessKey, number );
+	CFRelease( number );
+	
+	number = CFNumberCreate( NULL, kCFNumberDoubleType, &sLastGeneration );
+	CFDictionarySetValue( result, kMirrorGenerationKey, number );
+	CFRelease( number );
+	
+	if ( inEdits )
+	{
+		number = CFNumberCreate( NULL, kCFNumberDoubleType, &inBase );
+		CFDictionarySetValue( result, kMirrorBaseKey, number );
+		CFRelease( number );
+		
+		CFDictionarySetValue( result, kMirrorEditsKey, inEdits );
+	}
+	else
+	{
+		CFDictionarySetValue( result, kMirrorItemsKey, inItems );
+	}
+
+CantCreateUpdate:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	CreateItemEdits
+//-----------------------------------------------------------------------------
+//	Describe inItems in terms of inBase: an array in the new order, holding
+//	the index in inBase of each item we already had (wherever it was), or the
+//	item itself if it is new or its data changed. Items left out were
+//	removed. Returns NULL if no item could be reused, since then the full
+//	list is smaller.
+//
+static CFArrayRef
+CreateItemEdits( CFArrayRef inBase, CFArrayRef inItems )
+{
+	CFMutableDictionaryRef	positions;
+	CFMutableArrayRef		result = NULL;
+	CFIndex					i, count, reused = 0;
+	
+	positions = CFDictionaryCreateMutable( NULL, 0, &kCFTypeDictionaryKeyCallBacks, NULL );
+	require( positions != NULL, CantCreatePositions );
+	
+	// Walk backwards so that where an item appears twice (separators, say),
+	// we use the first one.
+	
+	for ( i = CFArrayGetCount( inBase ) - 1; i >= 0; i-- )
+		CFDictionarySetValue( positions, CFArrayGetValueAtIndex( inBase, i ), (const void*)i );
+	
+	count = CFArrayGetCount( inItems );
+	result = CFArrayCreateMutable( NULL, count, &kCFTypeArrayCallBacks );
+	require( result != NULL, CantCreateResult );
+	
+	for ( i = 0; i < count; i++ )
+	{
+		CFTypeRef		item = CFArrayGetValueAtIndex( inItems, i );
+		const void*		position;
+		
+		if ( CFDictionaryGetValueIfPresent( positions, item, &position ) )
+		{
+			SInt32			index = (SInt32)(CFIndex)position;
+			CFNumberRef		number = CFNumberCreate( NULL, kCFNumberSInt32Type, &index );
+			
+			CFArrayAppendValue( result, number );
+			CFRelease( number );
+			reused++;
+		}
+		else
+		{
+			CFArrayAppendValue( result, item );
+		}
+	}
+	
+	if ( reused == 0 )
+	{
+		CFRelease( result );
+		result = NULL;
+	}
+
+CantCreateResult:
+	CFRelease( positions );
+
+CantCreatePositions:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	CreateItemsFromEdits
+//-----------------------------------------------------------------------------
+//	The reverse of CreateItemEdits. Returns NULL if the edits don't make sense
+//	against inBase.
+//
+static CFArrayRef
+CreateItemsFromEdits( CFArrayRef inBase, CFArrayRef inEdits )
+{
+	CFMutableArrayRef	result;
+	CFIndex				i, count = CFArrayGetCount( inEdits );
+	CFIndex				baseCount = CFArrayGetCount( inBase );
+	
+	result = CFArrayCreateMutable( NULL, count, &kCFTypeArrayCallBacks );
+	require( result != NULL, CantCreateResult );
+	
+	for ( i = 0; i < count; i++ )
+	{
+		CFTypeRef		edit = CFArrayGetValueAtIndex( inEdits, i );
+		SInt32			index;
+		
+		if ( CFGetTypeID( edit ) == CFDictionaryGetTypeID() )
+		{
+			require( IsValidItemDescriptor( edit ), BadEdit );
+			CFArrayAppendValue( result, edit );
+		}
+		else
+		{
+			require( CFGetTypeID( edit ) == CFNumberGetTypeID()
+					&& CFNumberGetValue( (CFNumberRef)edit, kCFNumberSInt32Type, &index )
+					&& index >= 0 && index < baseCount, BadEdit );
+			
+			CFArrayAppendValue( result, CFArrayGetValueAtIndex( inBase, index ) );
+		}
+	}
+	
+	return result;
+
+BadEdit:
+	CFRelease( result );
+
+CantCreateResult:
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	GetUpdateNumber
+//-----------------------------------------------------------------------------
+//	Fetch a number from an update, failing if it is missing or isn't a number.
+//
+static Boolean
+GetUpdateNumber( CFDictionaryRef inUpdate, CFStringRef inKey, CFNumberType inType, void* outValue )
+{
+	CFTypeRef		value = CFDictionaryGetValue( inUpdate, inKey );
+	
+	return value != NULL && CFGetTypeID( value ) == CFNumberGetTypeID()
+			&& CFNumberGetValue( (CFNumberRef)value, inType, outValue );
+}
+
+//-----------------------------------------------------------------------------
+//	IsValidItemDescriptor
+//-----------------------------------------------------------------------------
+//	An item descriptor needs a string identifier. The config data, if any, is
+//	left for the item to check, since only it knows what it saved.
+//
+static Boolean
+IsValidItemDescriptor( CFTypeRef inDescriptor )
+{
+	CFTypeRef		identifier;
+	
+	if ( CFGetTypeID( inDescriptor ) != CFDictionaryGetTypeID() )
+		return false;
+	
+	identifier = CFDictionaryGetValue( (CFDictionaryRef)inDescriptor, kToolbarItemIdentifierKey );
+	
+	return identifier != NULL && CFGetTypeID( identifier ) == CFStringGetTypeID();
+}
+
+//-----------------------------------------------------------------------------
+//	AreValidItems
+//-----------------------------------------------------------------------------
+//
+static Boolean
+AreValidItems( CFArrayRef inItems )
+{
+	CFIndex		i, count = CFArrayGetCount( inItems );
+	
+	for ( i = 0; i < count; i++ )
+	{
+		if ( !IsValidItemDescriptor( CFArrayGetValueAtIndex( inItems, i ) ) )
+			return false;
+	}
+	
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	SetLastItems
+//-----------------------------------------------------------------------------
+//
+static void
+SetLastItems( CFArrayRef inItems )
+{
+	CFRetain( inItems );
+	if ( sLastItems )
+		CFRelease( sLastItems );
+	sLastItems = inItems;
+}
+
+//-----------------------------------------------------------------------------
+//	NoteMirrorUpdate
+//-----------------------------------------------------------------------------
+//	Count an update we sent. The byte counts mean flattening the update, and
+//	for a delta building and flattening the full update it stands in for, so
+//	we only work them out when the stats are being dumped. Either way, that
+//	is done after the update was timed.
+//
+static void
+NoteMirrorUpdate( CFDictionaryRef inUpdate, CFArrayRef inItems, Boolean inDelta, EventTime inElapsed )
+{
+	if ( IsToolbarStatsDumpEnabled() )
+	{
+		CFIndex		written = GetPropertyListSize( inUpdate );
+		CFIndex		full = written;
+		
+		if ( inDelta )
+		{
+			CFDictionaryRef		fullUpdate = CreateMirrorUpdate( inItems, NULL, 0 );
+			
+			if ( fullUpdate )
+			{
+				full = GetPropertyListSize( fullUpdate );
+				CFRelease( fullUpdate );
+			}
+		}
+		
+		sStats.bytesWritten += written;
+		sStats.fullBytes += full;
+	}
+	
+	if ( inDelta )
+		sStats.deltaPublishes++;
+	sStats.publishes++;
+	sStats.totalPublishTime += inElapsed;
+	if ( inElapsed > sStats.longestPublish )
+		sStats.longestPublish = inElapsed;
+}
+
+//-----------------------------------------------------------------------------
+//	CopyMirrorStatsSection
+//-----------------------------------------------------------------------------
+//	Our stats for the stats dump, with times in nanoseconds. Comparing
+//	bytesWritten with fullBytes shows what sending only the edits saves.
+//
+static CFDictionaryRef
+CopyMirrorStatsSection()
+{
+	CFMutableDictionaryRef	result;
+	
+	result = CFDictionaryCreateMutable( NULL, 7,
+			&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	require( result != NULL, CantCreateResult );
+	
+	AddToolbarStatsValue( result, CFSTR( "publishes" ), sStats.publishes );
+	AddToolbarStatsValue( result, CFSTR( "deltaPublishes" ), sStats.deltaPublishes );
+	AddToolbarStatsValue( result, CFSTR( "resyncs" ), sStats.resyncs );
+	AddToolbarStatsValue( result, CFSTR( "bytesWritten" ), sStats.bytesWritten );
+	AddToolbarStatsValue( result, CFSTR( "fullBytes" ), sStats.fullBytes );
+	AddToolbarStatsValue( result, CFSTR( "totalPublishTime" ),
+			(SInt64)( sStats.totalPublishTime / kEventDurationNanosecond ) );
+	AddToolbarStatsValue( result, CFSTR( "longestPublish" ),
+			(SInt64)( sStats.longestPublish / kEventDurationNanosecond ) );
+
+CantCreateResult:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	GetPropertyListSize
+//-----------------------------------------------------------------------------
+//
+static CFIndex
+GetPropertyListSize( CFPropertyListRef inPlist )
+{
+	CFDataRef		data = CFPropertyListCreateXMLData( NULL, inPlist );
+	CFIndex			result = 0;
+	
+	if ( data )
+	{
+		result = CFDataGetLength( data );
+		CFRelease( data );
+	}
+	
+	return result;
+}
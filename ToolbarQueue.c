@@ -0,0 +1,219 @@
+/*
+    File:		ToolbarQueue.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include <libkern/OSAtomic.h>
+
+#include "ToolbarQueue.h"
+
+// Everything that touches the toolbars has to happen on the main thread.
+// This is how other threads get work over there: they drop a proc and its
+// data into a fixed size ring, and the main event loop calls it. The ring
+// can be posted to from any number of threads without taking a lock, and
+// only the main thread ever takes things out of it.
+//
+// Indices only ever go up, and are allowed to wrap around, so they are
+// unsigned and compared by the sign of their difference.
+//
+// Posting an event for every entry would be wasteful when a thread posts a
+// burst of updates, so we only post one when the main thread isn't already
+// on its way. It then runs everything in the ring in one go.
+
+enum
+{
+	kToolbarQueueSize			= 1024,		// must be a power of two
+	
+	kEventClassToolbarQueue		= 'CTbq',
+	kEventToolbarQueueDrain		= 1
+};
+
+struct ToolbarQueueEntry
+{
+	volatile uint32_t		sequence;
+	ToolbarQueueProcPtr		proc;
+	void*					data;
+};
+typedef struct ToolbarQueueEntry ToolbarQueueEntry;
+
+static ToolbarQueueEntry	sEntries[ kToolbarQueueSize ];
+static volatile int32_t		sEnqueueIndex;		// a uint32_t, as OSAtomic wants it
+static uint32_t				sDequeueIndex;
+static volatile int32_t		sDrainPending;
+
+static const EventTypeSpec kQueueEvents[] =
+{
+	{ kEventClassToolbarQueue, kEventToolbarQueueDrain }
+};
+
+static void				DrainToolbarQueue();
+static OSStatus			ToolbarQueueHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+
+//-----------------------------------------------------------------------------
+//	InstallToolbarQueue
+//-----------------------------------------------------------------------------
+//	Must be called on the main thread before anybody posts to the queue.
+//
+void
+InstallToolbarQueue()
+{
+	uint32_t	i;
+	
+	// Each slot's sequence number tells posters and the main thread whose
+	// turn it is. A slot is free to post into when its sequence matches the
+	// index being posted, and ready to run when it is one past that.
+	
+	for ( i = 0; i < kToolbarQueueSize; i++ )
+		sEntries[ i ].sequence = i;
+	
+	OSMemoryBarrier();
+	
+	InstallApplicationEventHandler( ToolbarQueueHandler, GetEventTypeCount( kQueueEvents ),
+			kQueueEvents, NULL, NULL );
+}
+
+//-----------------------------------------------------------------------------
+//	PostToToolbarQueue
+//-----------------------------------------------------------------------------
+//	Ask the main thread to call inProc( inData ). This may be called from any
+//	thread. If the queue is full we return false and nothing is posted; the
+//	caller still owns inData in that case.
+//
+Boolean
+PostToToolbarQueue( ToolbarQueueProcPtr inProc, void* inData )
+{
+	ToolbarQueueEntry*	entry;
+	uint32_t			index;
+	
+	// Claim a slot by bumping the enqueue index past it. If the slot's
+	// sequence is behind, the main thread hasn't emptied it yet and the
+	// queue is full.
+	
+	for ( ;; )
+	{
+		index = (uint32_t)sEnqueueIndex;
+		entry = &sEntries[ index & ( kToolbarQueueSize - 1 ) ];
+		
+		if ( entry->sequence == index )
+		{
+			if ( OSAtomicCompareAndSwap32Barrier( (int32_t)index, (int32_t)( index + 1 ), &sEnqueueIndex ) )
+				break;
+		}
+		else if ( (int32_t)( entry->sequence - index ) < 0 )
+		{
+			return false;
+		}
+	}
+	
+	entry->proc = inProc;
+	entry->data = inData;
+	
+	OSMemoryBarrier();
+	entry->sequence = index + 1;
+	
+	// Only the first post since the main thread last drained the queue needs
+	// to wake it up.
+	
+	if ( OSAtomicCompareAndSwap32Barrier( 0, 1, &sDrainPending ) )
+	{
+		EventRef		event;
+		EventTargetRef	target = GetApplicationEventTarget();
+		
+		if ( CreateEvent( NULL, kEventClassToolbarQueue, kEventToolbarQueueDrain,
+				GetCurrentEventTime(), kEventAttributeNone, &event ) == noErr )
+		{
+			SetEventParameter( event, kEventParamPostTarget, typeEventTargetRef,
+					sizeof( EventTargetRef ), &target );
+			PostEventToQueue( GetMainEventQueue(), event, kEventPriorityStandard );
+			ReleaseEvent( event );
+		}
+	}
+	
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	DrainToolbarQueue
+//-----------------------------------------------------------------------------
+//	Run everything that has been posted. We clear the pending flag before we
+//	start, so anything posted while we are running will post a new event
+//	rather than sitting in the queue unnoticed.
+//
+static void
+DrainToolbarQueue()
+{
+	OSAtomicCompareAndSwap32Barrier( 1, 0, &sDrainPending );
+	
+	for ( ;; )
+	{
+		ToolbarQueueEntry*	entry = &sEntries[ sDequeueIndex & ( kToolbarQueueSize - 1 ) ];
+		ToolbarQueueProcPtr	proc;
+		void*				data;
+		
+		if ( entry->sequence != sDequeueIndex + 1 )
+			break;
+		
+		OSMemoryBarrier();
+		proc = entry->proc;
+		data = entry->data;
+		
+		// Hand the slot back to the posters before calling the proc, in case
+		// the proc wants to post something itself.
+		
+		OSMemoryBarrier();
+		entry->sequence = sDequeueIndex + kToolbarQueueSize;
+		sDequeueIndex++;
+		
+		proc( data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarQueueHandler
+//-----------------------------------------------------------------------------
+//
+static OSStatus
+ToolbarQueueHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
+{
+	DrainToolbarQueue();
+	
+	return noErr;
+}
@@ -0,0 +1,518 @@
+/*
+    File:		ToolbarStats.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include <libkern/OSAtomic.h>
+#include <mach/mach_time.h>
+
+#include "ToolbarStats.h"
+
+// Counts of the objects (and roughly how many bytes) each part of the app is
+// holding onto, along with the most it has held at once. Counters are bumped
+// from wherever objects are made and let go of, so updating them has to be
+// cheap; we use plain atomic adds with no barriers, since nobody depends on
+// the counters being in step with anything else.
+//
+// We also time each command as it is dispatched. Commands are only ever
+// dispatched on the main thread, so these counters are plain ones; noting a
+// command costs a clock read, a short search and a few adds.
+//
+// Setting the StatsDumpInterval preference to a number of seconds makes us
+// write the counters to stderr as an XML property list that often, e.g.:
+//
+//		defaults write com.apple.carbontoolbar StatsDumpInterval 5
+
+static ToolbarStatsCounter	sCounters[ kToolbarStatsSubsystemCount ];
+
+static const CFStringRef	kSubsystemNames[ kToolbarStatsSubsystemCount ] =
+{
+	CFSTR( "toolbars" ),
+	CFSTR( "customItems" ),
+	CFSTR( "urls" ),
+	CFSTR( "icons" ),
+	CFSTR( "menus" ),
+	CFSTR( "snapshots" )
+};
+
+static ToolbarCommandStats	sCommandStats[ kMaxToolbarCommandStats ];
+static ItemCount			sCommandStatsCount;
+static mach_timebase_info_data_t	sTimebase;
+static Boolean				sDumpEnabled;
+static CFStringRef			sSectionNames[ kMaxToolbarStatsSections ];
+static ToolbarStatsSectionProcPtr	sSectionProcs[ kMaxToolbarStatsSections ];
+static ItemCount			sSectionCount;
+
+static void				RaisePeak( volatile int32_t* ioPeak, int32_t inValue );
+static CFDictionaryRef	CopyCommandStats();
+static void				AddCounterValue( CFMutableDictionaryRef inDict, CFStringRef inKey, SInt32 inValue );
+static void				AddCounterValue64( CFMutableDictionaryRef inDict, CFStringRef inKey, SInt64 inValue );
+static void				ToolbarStatsDumpTimer( EventLoopTimerRef inTimer, void* inUserData );
+
+//-----------------------------------------------------------------------------
+//	ToolbarStatsAdd
+//-----------------------------------------------------------------------------
+//	Note that a subsystem made (positive counts) or let go of (negative counts)
+//	some objects. Safe to call from any thread.
+//
+void
+ToolbarStatsAdd( UInt32 inSubsystem, SInt32 inObjects, SInt32 inBytes )
+{
+	ToolbarStatsCounter*	counter = &sCounters[ inSubsystem ];
+	int32_t					objects, bytes;
+	
+	objects = OSAtomicAdd32( inObjects, &counter->objects );
+	bytes = OSAtomicAdd32( inBytes, &counter->bytes );
+	
+	if ( inObjects > 0 )
+		RaisePeak( &counter->peakObjects, objects );
+	if ( inBytes > 0 )
+		RaisePeak( &counter->peakBytes, bytes );
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarStats
+//-----------------------------------------------------------------------------
+//
+void
+GetToolbarStats( UInt32 inSubsystem, ToolbarStatsCounter* outCounter )
+{
+	*outCounter = sCounters[ inSubsystem ];
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarStatsNoteCommand
+//-----------------------------------------------------------------------------
+//	A command we started dispatching at inStartTime (from mach_absolute_time)
+//	is done. Main thread only. Once we are tracking as many commands as we
+//	can, new ones aren't counted.
+//
+void
+ToolbarStatsNoteCommand( UInt32 inCommandID, UInt64 inStartTime )
+{
+	UInt64					now = mach_absolute_time();
+	UInt64					elapsed;
+	ToolbarCommandStats*	stats;
+	UInt32					bucket;
+	ItemCount				i;
+	
+	for ( i = 0; i < sCommandStatsCount; i++ )
+	{
+		if ( sCommandStats[ i ].commandID == inCommandID )
+			break;
+	}
+	
+	if ( i == sCommandStatsCount )
+	{
+		require_quiet( sCommandStatsCount < kMaxToolbarCommandStats, TooManyCommands );
+		sCommandStats[ i ].commandID = inCommandID;
+		sCommandStats[ i ].firstSeen = now;
+		sCommandStatsCount++;
+	}
+	
+	stats = &sCommandStats[ i ];
+	elapsed = now - inStartTime;
+	
+	if ( elapsed < kToolbarCommandSubBuckets )
+		bucket = elapsed;
+	else
+	{
+		UInt32		power = 63 - __builtin_clzll( elapsed );
+		
+		bucket = ( power - kToolbarCommandSubBucketBits + 1 ) * kToolbarCommandSubBuckets
+				+ ( ( elapsed >> ( power - kToolbarCommandSubBucketBits ) ) & ( kToolbarCommandSubBuckets - 1 ) );
+		if ( bucket >= kToolbarCommandLatencyBuckets )
+			bucket = kToolbarCommandLatencyBuckets - 1;
+	}
+	
+	stats->count++;
+	stats->buckets[ bucket ]++;
+	stats->totalTime += elapsed;
+	if ( elapsed > stats->longestTime )
+		stats->longestTime = elapsed;
+	stats->lastSeen = now;
+
+TooManyCommands:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarCommandStats
+//-----------------------------------------------------------------------------
+//	Copy out the stats of up to inMaxStats commands, in the order we first saw
+//	them. Returns how many were copied.
+//
+ItemCount
+GetToolbarCommandStats( ToolbarCommandStats* outStats, ItemCount inMaxStats )
+{
+	ItemCount		count = ( sCommandStatsCount < inMaxStats ) ? sCommandStatsCount : inMaxStats;
+	
+	memcpy( outStats, sCommandStats, count * sizeof( ToolbarCommandStats ) );
+	
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarStatsNanoseconds
+//-----------------------------------------------------------------------------
+//	Convert a duration from mach_absolute_time units. On Intel they are
+//	already nanoseconds. Elsewhere the scale can be large (on PowerPC the
+//	numerator is around 10^9), so we split the duration to keep the multiply
+//	from overflowing; a raw timestamp would overflow within minutes.
+//
+UInt64
+GetToolbarStatsNanoseconds( UInt64 inDuration )
+{
+	if ( sTimebase.denom == 0 )
+		mach_timebase_info( &sTimebase );
+	
+	if ( sTimebase.numer == sTimebase.denom )
+		return inDuration;
+	
+	return ( inDuration / sTimebase.denom ) * sTimebase.numer
+			+ ( inDuration % sTimebase.denom ) * sTimebase.numer / sTimebase.denom;
+}
+
+//-----------------------------------------------------------------------------
+//	GetToolbarCommandBucketStart
+//-----------------------------------------------------------------------------
+//	The shortest duration, in mach_absolute_time units, that goes in a
+//	histogram bucket.
+//
+UInt64
+GetToolbarCommandBucketStart( UInt32 inBucket )
+{
+	UInt32		power = inBucket / kToolbarCommandSubBuckets + kToolbarCommandSubBucketBits - 1;
+	UInt64		sub = inBucket % kToolbarCommandSubBuckets;
+	
+	if ( inBucket < kToolbarCommandSubBuckets )
+		return inBucket;
+	
+	return ( kToolbarCommandSubBuckets + sub ) << ( power - kToolbarCommandSubBucketBits );
+}
+
+//-----------------------------------------------------------------------------
+//	CopyToolbarStats
+//-----------------------------------------------------------------------------
+//	All of our counters as a property list: a dictionary keyed by subsystem
+//	name, each holding objects, bytes, peakObjects and peakBytes, plus our
+//	command timings under "commands" (see CopyCommandStats) and each
+//	installed section under its name.
+//
+CFDictionaryRef
+CopyToolbarStats()
+{
+	CFMutableDictionaryRef	result;
+	UInt32					i;
+	
+	result = CFDictionaryCreateMutable( NULL, kToolbarStatsSubsystemCount,
+			&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	require( result != NULL, CantCreateResult );
+	
+	for ( i = 0; i < kToolbarStatsSubsystemCount; i++ )
+	{
+		CFMutableDictionaryRef	subsystem;
+		ToolbarStatsCounter		counter;
+		
+		GetToolbarStats( i, &counter );
+		
+		subsystem = CFDictionaryCreateMutable( NULL, 4,
+				&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+		if ( subsystem )
+		{
+			AddCounterValue( subsystem, CFSTR( "objects" ), counter.objects );
+			AddCounterValue( subsystem, CFSTR( "bytes" ), counter.bytes );
+			AddCounterValue( subsystem, CFSTR( "peakObjects" ), counter.peakObjects );
+			AddCounterValue( subsystem, CFSTR( "peakBytes" ), counter.peakBytes );
+			
+			CFDictionarySetValue( result, kSubsystemNames[ i ], subsystem );
+			CFRelease( subsystem );
+		}
+	}
+	
+	{
+		CFDictionaryRef		commands = CopyCommandStats();
+		
+		if ( commands )
+		{
+			CFDictionarySetValue( result, CFSTR( "commands" ), commands );
+			CFRelease( commands );
+		}
+	}
+	
+	for ( i = 0; i < sSectionCount; i++ )
+	{
+		CFDictionaryRef		section = sSectionProcs[ i ]();
+		
+		if ( section )
+		{
+			CFDictionarySetValue( result, sSectionNames[ i ], section );
+			CFRelease( section );
+		}
+	}
+
+CantCreateResult:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	InstallToolbarStatsDump
+//-----------------------------------------------------------------------------
+//	If the user asked for it in our prefs, dump our counters periodically.
+//
+void
+InstallToolbarStatsDump()
+{
+	CFIndex		interval;
+	Boolean		valid;
+	
+	interval = CFPreferencesGetAppIntegerValue( CFSTR( "StatsDumpInterval" ),
+			kCFPreferencesCurrentApplication, &valid );
+	
+	if ( valid && interval > 0 )
+	{
+		sDumpEnabled = true;
+		InstallEventLoopTimer( GetMainEventLoop(), interval * kEventDurationSecond,
+				interval * kEventDurationSecond, NewEventLoopTimerUPP( ToolbarStatsDumpTimer ),
+				NULL, NULL );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	IsToolbarStatsDumpEnabled
+//-----------------------------------------------------------------------------
+//	Lets counters that are costly to keep skip the work when nobody will see
+//	them.
+//
+Boolean
+IsToolbarStatsDumpEnabled()
+{
+	return sDumpEnabled;
+}
+
+//-----------------------------------------------------------------------------
+//	InstallToolbarStatsSection
+//-----------------------------------------------------------------------------
+//	Add a section to the stats. Main thread only, like copying the stats.
+//
+void
+InstallToolbarStatsSection( CFStringRef inName, ToolbarStatsSectionProcPtr inProc )
+{
+	require( sSectionCount < kMaxToolbarStatsSections, TooManySections );
+	
+	sSectionNames[ sSectionCount ] = (CFStringRef)CFRetain( inName );
+	sSectionProcs[ sSectionCount ] = inProc;
+	sSectionCount++;
+
+TooManySections:
+	return;
+}
+
+//-----------------------------------------------------------------------------
+//	AddToolbarStatsValue
+//-----------------------------------------------------------------------------
+//	For sections to fill in their dictionaries the way we fill in ours.
+//
+void
+AddToolbarStatsValue( CFMutableDictionaryRef inDict, CFStringRef inKey, SInt64 inValue )
+{
+	AddCounterValue64( inDict, inKey, inValue );
+}
+
+//-----------------------------------------------------------------------------
+//	RaisePeak
+//-----------------------------------------------------------------------------
+//	Bump a high-water mark up to inValue, unless another thread got it there
+//	(or higher) first.
+//
+static void
+RaisePeak( volatile int32_t* ioPeak, int32_t inValue )
+{
+	int32_t		peak;
+	
+	do
+	{
+		peak = *ioPeak;
+		if ( inValue <= peak )
+			break;
+	}
+	while ( !OSAtomicCompareAndSwap32( peak, inValue, ioPeak ) );
+}
+
+//-----------------------------------------------------------------------------
+//	CopyCommandStats
+//-----------------------------------------------------------------------------
+//	Our command timings as a dictionary keyed by command ID (as four
+//	characters), each holding count, totalTime and longestTime (in
+//	nanoseconds), perSecond (the rate between the first and last time we saw
+//	the command), histogram (the counts of the buckets that aren't empty) and
+//	histogramStart (where each of those buckets starts, in nanoseconds).
+//
+static CFDictionaryRef
+CopyCommandStats()
+{
+	CFMutableDictionaryRef	result;
+	ItemCount				i;
+	
+	result = CFDictionaryCreateMutable( NULL, sCommandStatsCount,
+			&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+	require( result != NULL, CantCreateResult );
+	
+	for ( i = 0; i < sCommandStatsCount; i++ )
+	{
+		const ToolbarCommandStats*	stats = &sCommandStats[ i ];
+		CFMutableDictionaryRef		command;
+		CFMutableArrayRef			histogram, histogramStart;
+		CFStringRef					name;
+		CFNumberRef					number;
+		UInt32						bucket;
+		double						perSecond = 0;
+		
+		command = CFDictionaryCreateMutable( NULL, 6,
+				&kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks );
+		if ( command == NULL )
+			continue;
+		
+		AddCounterValue( command, CFSTR( "count" ), stats->count );
+		AddCounterValue64( command, CFSTR( "totalTime" ), GetToolbarStatsNanoseconds( stats->totalTime ) );
+		AddCounterValue64( command, CFSTR( "longestTime" ), GetToolbarStatsNanoseconds( stats->longestTime ) );
+		
+		if ( stats->lastSeen > stats->firstSeen )
+			perSecond = ( stats->count - 1 ) * 1e9
+					/ GetToolbarStatsNanoseconds( stats->lastSeen - stats->firstSeen );
+		number = CFNumberCreate( NULL, kCFNumberDoubleType, &perSecond );
+		CFDictionarySetValue( command, CFSTR( "perSecond" ), number );
+		CFRelease( number );
+		
+		histogram = CFArrayCreateMutable( NULL, 0, &kCFTypeArrayCallBacks );
+		histogramStart = CFArrayCreateMutable( NULL, 0, &kCFTypeArrayCallBacks );
+		for ( bucket = 0; bucket < kToolbarCommandLatencyBuckets; bucket++ )
+		{
+			SInt64		start;
+			
+			if ( stats->buckets[ bucket ] == 0 )
+				continue;
+			
+			start = GetToolbarStatsNanoseconds( GetToolbarCommandBucketStart( bucket ) );
+			
+			number = CFNumberCreate( NULL, kCFNumberSInt32Type, &stats->buckets[ bucket ] );
+			CFArrayAppendValue( histogram, number );
+			CFRelease( number );
+			
+			number = CFNumberCreate( NULL, kCFNumberSInt64Type, &start );
+			CFArrayAppendValue( histogramStart, number );
+			CFRelease( number );
+		}
+		CFDictionarySetValue( command, CFSTR( "histogram" ), histogram );
+		CFDictionarySetValue( command, CFSTR( "histogramStart" ), histogramStart );
+		CFRelease( histogram );
+		CFRelease( histogramStart );
+		
+		name = CFStringCreateWithFormat( NULL, NULL, CFSTR( "%c%c%c%c" ),
+				(char)( stats->commandID >> 24 ), (char)( stats->commandID >> 16 ),
+				(char)( stats->commandID >> 8 ), (char)stats->commandID );
+		CFDictionarySetValue( result, name, command );
+		CFRelease( name );
+		CFRelease( command );
+	}
+
+CantCreateResult:
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	AddCounterValue
+//-----------------------------------------------------------------------------
+//
+static void
+AddCounterValue( CFMutableDictionaryRef inDict, CFStringRef inKey, SInt32 inValue )
+{
+	CFNumberRef		number = CFNumberCreate( NULL, kCFNumberSInt32Type, &inValue );
+	
+	if ( number )
+	{
+		CFDictionarySetValue( inDict, inKey, number );
+		CFRelease( number );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	AddCounterValue64
+//-----------------------------------------------------------------------------
+//
+static void
+AddCounterValue64( CFMutableDictionaryRef inDict, CFStringRef inKey, SInt64 inValue )
+{
+	CFNumberRef		number = CFNumberCreate( NULL, kCFNumberSInt64Type, &inValue );
+	
+	if ( number )
+	{
+		CFDictionarySetValue( inDict, inKey, number );
+		CFRelease( number );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarStatsDumpTimer
+//-----------------------------------------------------------------------------
+//
+static void
+ToolbarStatsDumpTimer( EventLoopTimerRef inTimer, void* inUserData )
+{
+	CFDictionaryRef		stats;
+	CFDataRef			data;
+	
+	stats = CopyToolbarStats();
+	require( stats != NULL, CantCopyStats );
+	
+	data = CFPropertyListCreateXMLData( NULL, stats );
+	if ( data )
+	{
+		fwrite( CFDataGetBytePtr( data ), 1, CFDataGetLength( data ), stderr );
+		fflush( stderr );
+		CFRelease( data );
+	}
+	
+	CFRelease( stats );
+
+CantCopyStats:
+	return;
+}
@@ -0,0 +1,132 @@
+/*
+    File:		ToolbarStats.h
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#ifndef CarbonToolbar_TOOLBARSTATS
+#define CarbonToolbar_TOOLBARSTATS
+
+#include <Carbon/Carbon.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+	kToolbarStatsToolbars		= 0,
+	kToolbarStatsCustomItems	= 1,
+	kToolbarStatsURLs			= 2,
+	kToolbarStatsIcons			= 3,
+	kToolbarStatsMenus			= 4,
+	kToolbarStatsSnapshots		= 5,
+	kToolbarStatsSubsystemCount	= 6
+};
+
+struct ToolbarStatsCounter
+{
+	int32_t			objects;
+	int32_t			bytes;
+	int32_t			peakObjects;
+	int32_t			peakBytes;
+};
+typedef struct ToolbarStatsCounter ToolbarStatsCounter;
+
+// How long the commands we dispatch take, and how often they come. Times
+// are kept as they come from mach_absolute_time, so noting a command needs
+// no conversion; GetToolbarStatsNanoseconds turns a duration (never a raw
+// timestamp) into nanoseconds.
+//
+// The histogram is laid out the way an HDR histogram is: each power of two
+// is split into kToolbarCommandSubBuckets equal buckets, so a bucket is never
+// wider than 1/8 of the values in it (about 12% precision) however long the
+// command took. Durations under 8 units get a bucket each; after that,
+// buckets 8n to 8n+7 cover 2^(n+2) up to 2^(n+3) units. Anything longer than
+// the last bucket is counted in it.
+
+enum
+{
+	kToolbarCommandSubBucketBits	= 3,
+	kToolbarCommandSubBuckets		= 1 << kToolbarCommandSubBucketBits,
+	kToolbarCommandLatencyBuckets	= 32 * kToolbarCommandSubBuckets,
+	kMaxToolbarCommandStats			= 16
+};
+
+struct ToolbarCommandStats
+{
+	UInt32			commandID;
+	UInt32			count;
+	UInt64			totalTime;
+	UInt64			longestTime;
+	UInt64			firstSeen;
+	UInt64			lastSeen;
+	UInt32			buckets[ kToolbarCommandLatencyBuckets ];
+};
+typedef struct ToolbarCommandStats ToolbarCommandStats;
+
+// Other parts of the app with numbers of their own add them to ours as a
+// section: a dictionary, kept under the section's name, that the proc makes
+// afresh each time the stats are copied.
+
+typedef CFDictionaryRef (*ToolbarStatsSectionProcPtr)();
+
+enum
+{
+	kMaxToolbarStatsSections		= 4
+};
+
+extern void					ToolbarStatsAdd( UInt32 inSubsystem, SInt32 inObjects, SInt32 inBytes );
+extern void					GetToolbarStats( UInt32 inSubsystem, ToolbarStatsCounter* outCounter );
+extern void					ToolbarStatsNoteCommand( UInt32 inCommandID, UInt64 inStartTime );
+extern ItemCount			GetToolbarCommandStats( ToolbarCommandStats* outStats, ItemCount inMaxStats );
+extern UInt64				GetToolbarStatsNanoseconds( UInt64 inDuration );
+extern UInt64				GetToolbarCommandBucketStart( UInt32 inBucket );
+extern CFDictionaryRef		CopyToolbarStats();
+extern void					InstallToolbarStatsDump();
+extern Boolean				IsToolbarStatsDumpEnabled();
+extern void					InstallToolbarStatsSection( CFStringRef inName, ToolbarStatsSectionProcPtr inProc );
+extern void					AddToolbarStatsValue( CFMutableDictionaryRef inDict, CFStringRef inKey, SInt64 inValue );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CarbonToolbar_TOOLBARSTATS
@@ -0,0 +1,394 @@
+/*
+    File:		ToolbarURL.c
+    
+    Version:	Mac OS X
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+				("Apple") in consideration of your agreement to the following terms, and your
+				use, installation, modification or redistribution of this Apple software
+				constitutes acceptance of these terms.  If you do not agree with these terms,
+				please do not use, install, modify or redistribute this Apple software.
+
+				In consideration of your agreement to abide by the following terms, and subject
+				to these terms, Apple grants you a personal, non-exclusive license, under Apples
+				copyrights in this original Apple software (the "Apple Software"), to use,
+				reproduce, modify and redistribute the Apple Software, with or without
+				modifications, in source and/or binary forms; provided that if you redistribute
+				the Apple Software in its entirety and without modifications, you must retain
+				this notice and the following text and disclaimers in all such redistributions of
+				the Apple Software.  Neither the name, trademarks, service marks or logos of
+				Apple Computer, Inc. may be used to endorse or promote products derived from the
+				Apple Software without specific prior written permission from Apple.  Except as
+				expressly stated in this notice, no other rights or licenses, express or implied,
+				are granted by Apple herein, including but not limited to any patent rights that
+				may be infringed by your derivative works or by other works in which the Apple
+				Software may be incorporated.
+
+				The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+				WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+				WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+				PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+				COMBINATION WITH YOUR PRODUCTS.
+
+				IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+				CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+				GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+				ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+				OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+				(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+				ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Copyright  2002 Apple Computer, Inc., All Rights Reserved
+*/
+
+#include <ctype.h>
+
+#include "ToolbarURL.h"
+
+// Checks a URL string and puts it in a canonical form, so that two spellings
+// of the same URL end up as the same item, and get saved the same way. We
+// make a single pass over the string, looking each character up in a table
+// that says where in a URL it may appear. The canonical form has:
+//
+//	- the scheme and host in lower case ("http" is assumed if there is none;
+//	  "www.apple.com:8080/x" and "localhost:8080" are a host and port, not a
+//	  scheme, since a scheme we'd accept has no dots and no all-digit rest)
+//	- no port, if it is the scheme's default port
+//	- a "/" path, rather than an empty one, after a host
+//	- upper case hex digits in percent escapes
+//
+// Anything the URL syntax doesn't allow (spaces, non-ASCII characters, bad
+// escapes, and so on) makes the whole URL invalid. So does an empty host for
+// the schemes that need one (http, https and ftp); others, like file, can
+// leave it out.
+
+enum
+{
+	kURLAlpha		= 1 << 0,
+	kURLScheme		= 1 << 1,	// may follow the first letter of a scheme
+	kURLHost		= 1 << 2,	// may appear in a host name or user info
+	kURLPath		= 1 << 3,	// may appear in a path, query or fragment
+	kURLHex			= 1 << 4
+};
+
+#define kURLSchemeSeparator		':'
+#define kURLEscape				'%'
+
+static UInt8		sCharClasses[ 256 ];
+
+static void				InitCharClasses();
+static void				SetCharClass( const char* inChars, UInt8 inClass );
+static const char*		GetDefaultPort( const UInt8* inScheme, CFIndex inLength );
+static Boolean			CopyEscape( const UInt8* inSource, CFIndex inLength, CFIndex* ioIndex, UInt8* inDest, CFIndex* ioOut );
+static UInt8			LowerCase( UInt8 inChar );
+static Boolean			IsHostAndPort( const UInt8* inSource, CFIndex inLength, CFIndex inSchemeLength );
+
+//-----------------------------------------------------------------------------
+//	CreateNormalizedURL
+//-----------------------------------------------------------------------------
+//	Returns NULL if the string isn't a valid URL.
+//
+CFURLRef
+CreateNormalizedURL( CFStringRef inString )
+{
+	CFURLRef		result = NULL;
+	CFIndex			length, used, i, out = 0;
+	CFIndex			schemeLength, hostStart, hostEnd, portStart, portEnd;
+	UInt8*			source = NULL;
+	UInt8*			dest = NULL;
+	const char*		defaultPort;
+	Boolean			hierarchical;
+	CFStringRef		string;
+	
+	InitCharClasses();
+	
+	length = CFStringGetLength( inString );
+	require( length > 0, BadURL );
+	
+	// Anything outside ASCII isn't allowed in a URL, so asking for ASCII
+	// bytes with no loss byte stops at the first bad character.
+	
+	source = (UInt8*)malloc( length );
+	dest = (UInt8*)malloc( length + 16 );
+	require( source != NULL && dest != NULL, BadURL );
+	
+	CFStringGetBytes( inString, CFRangeMake( 0, length ), kCFStringEncodingASCII, 0, false, source, length, &used );
+	require( used == length, BadURL );
+	
+	// Scheme. If there isn't one, we take this to be a web address that the
+	// user typed without "http://".
+	
+	for ( i = 0; i < length && ( sCharClasses[ source[ i ] ] & kURLScheme ); i++ )
+		;
+	
+	if ( i > 0 && i < length && source[ i ] == kURLSchemeSeparator && ( sCharClasses[ source[ 0 ] ] & kURLAlpha )
+			&& !IsHostAndPort( source, length, i ) )
+	{
+		schemeLength = i;
+		for ( i = 0; i < schemeLength; i++ )
+			dest[ out++ ] = LowerCase( source[ i ] );
+		i = schemeLength + 1;
+		hierarchical = ( i + 1 < length && source[ i ] == '/' && source[ i + 1 ] == '/' );
+		if ( hierarchical )
+			i += 2;
+	}
+	else
+	{
+		memcpy( dest, "http", 4 );
+		out = schemeLength = 4;
+		i = 0;
+		hierarchical = true;
+	}
+	
+	defaultPort = GetDefaultPort( dest, schemeLength );
+	
+	dest[ out++ ] = kURLSchemeSeparator;
+	
+	if ( hierarchical )
+	{
+		CFIndex		authorityEnd, at;
+		
+		dest[ out++ ] = '/';
+		dest[ out++ ] = '/';
+		
+		// Find the end of the authority, and the user info (if any) in it.
+		
+		at = -1;
+		for ( authorityEnd = i; authorityEnd < length; authorityEnd++ )
+		{
+			UInt8		c = source[ authorityEnd ];
+			
+			if ( c == '/' || c == '?' || c == '#' )
+				break;
+			if ( c == '@' )
+				at = authorityEnd;
+		}
+		
+		if ( at >= 0 )
+		{
+			for ( ; i < at; i++ )
+			{
+				if ( source[ i ] == kURLEscape )
+					require( CopyEscape( source, length, &i, dest, &out ), BadURL );
+				else
+				{
+					require( ( sCharClasses[ source[ i ] ] & kURLHost ) || source[ i ] == ':', BadURL );
+					dest[ out++ ] = source[ i ];
+				}
+			}
+			dest[ out++ ] = source[ i++ ];
+		}
+		
+		// Host. Either a bracketed IPv6 address or a name, and in both cases
+		// case doesn't matter.
+		
+		hostStart = i;
+		if ( i < authorityEnd && source[ i ] == '[' )
+		{
+			dest[ out++ ] = source[ i++ ];
+			for ( ; i < authorityEnd && source[ i ] != ']'; i++ )
+			{
+				require( ( sCharClasses[ source[ i ] ] & kURLHex ) || source[ i ] == ':' || source[ i ] == '.', BadURL );
+				dest[ out++ ] = LowerCase( source[ i ] );
+			}
+			require( i < authorityEnd, BadURL );
+			dest[ out++ ] = source[ i++ ];
+		}
+		else
+		{
+			for ( ; i < authorityEnd && source[ i ] != ':'; i++ )
+			{
+				if ( source[ i ] == kURLEscape )
+					require( CopyEscape( source, length, &i, dest, &out ), BadURL );
+				else
+				{
+					require( sCharClasses[ source[ i ] ] & kURLHost, BadURL );
+					dest[ out++ ] = LowerCase( source[ i ] );
+				}
+			}
+		}
+		hostEnd = i;
+		require( hostEnd > hostStart || defaultPort == NULL, BadURL );
+		
+		// Port. All digits, and dropped if it's the default for the scheme.
+		
+		if ( i < authorityEnd )
+		{
+			require( source[ i ] == ':', BadURL );
+			portStart = ++i;
+			for ( ; i < authorityEnd; i++ )
+				require( source[ i ] >= '0' && source[ i ] <= '9', BadURL );
+			portEnd = i;
+			
+			if ( portEnd > portStart && ( defaultPort == NULL
+					|| strlen( defaultPort ) != (size_t)( portEnd - portStart )
+					|| memcmp( defaultPort, source + portStart, portEnd - portStart ) != 0 ) )
+			{
+				dest[ out++ ] = ':';
+				memcpy( dest + out, source + portStart, portEnd - portStart );
+				out += portEnd - portStart;
+			}
+		}
+		
+		if ( i == length || source[ i ] != '/' )
+			dest[ out++ ] = '/';
+	}
+	
+	// Path, query and fragment are copied as they are, apart from escapes.
+	
+	for ( ; i < length; i++ )
+	{
+		if ( source[ i ] == kURLEscape )
+			require( CopyEscape( source, length, &i, dest, &out ), BadURL );
+		else
+		{
+			require( sCharClasses[ source[ i ] ] & kURLPath, BadURL );
+			dest[ out++ ] = source[ i ];
+		}
+	}
+	
+	string = CFStringCreateWithBytes( NULL, dest, out, kCFStringEncodingASCII, false );
+	if ( string )
+	{
+		result = CFURLCreateWithString( NULL, string, NULL );
+		CFRelease( string );
+	}
+
+BadURL:
+	if ( source )
+		free( source );
+	if ( dest )
+		free( dest );
+	
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//	InitCharClasses
+//-----------------------------------------------------------------------------
+//	Fill in our character class table the first time we are called. The sets
+//	are the ones in RFC 3986.
+//
+static void
+InitCharClasses()
+{
+	static Boolean		sInited;
+	
+	if ( !sInited )
+	{
+		const char*		alpha = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+		const char*		digit = "0123456789";
+		const char*		unreserved = "-._~";
+		const char*		subDelims = "!$&'()*+,;=";
+		
+		SetCharClass( alpha, kURLAlpha | kURLScheme | kURLHost | kURLPath );
+		SetCharClass( digit, kURLScheme | kURLHost | kURLPath | kURLHex );
+		SetCharClass( "abcdefABCDEF", kURLHex );
+		SetCharClass( "+-.", kURLScheme );
+		SetCharClass( unreserved, kURLHost | kURLPath );
+		SetCharClass( subDelims, kURLHost | kURLPath );
+		SetCharClass( ":@/?#", kURLPath );
+		
+		sInited = true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	SetCharClass
+//-----------------------------------------------------------------------------
+//
+static void
+SetCharClass( const char* inChars, UInt8 inClass )
+{
+	for ( ; *inChars; inChars++ )
+		sCharClasses[ (UInt8)*inChars ] |= inClass;
+}
+
+//-----------------------------------------------------------------------------
+//	GetDefaultPort
+//-----------------------------------------------------------------------------
+//	The port a scheme uses when none is given. The scheme has already been
+//	put in lower case. These are also the schemes that must have a host.
+//
+static const char*
+GetDefaultPort( const UInt8* inScheme, CFIndex inLength )
+{
+	static const struct
+	{
+		const char*		scheme;
+		const char*		port;
+	}
+	kDefaultPorts[] =
+	{
+		{ "http", "80" },
+		{ "https", "443" },
+		{ "ftp", "21" }
+	};
+	UInt32		i;
+	
+	for ( i = 0; i < sizeof( kDefaultPorts ) / sizeof( kDefaultPorts[0] ); i++ )
+	{
+		if ( strlen( kDefaultPorts[ i ].scheme ) == (size_t)inLength
+				&& memcmp( kDefaultPorts[ i ].scheme, inScheme, inLength ) == 0 )
+			return kDefaultPorts[ i ].port;
+	}
+	
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	CopyEscape
+//-----------------------------------------------------------------------------
+//	Copy a percent escape, with its hex digits in upper case. On the way out,
+//	ioIndex is left on the last character of the escape.
+//
+static Boolean
+CopyEscape( const UInt8* inSource, CFIndex inLength, CFIndex* ioIndex, UInt8* inDest, CFIndex* ioOut )
+{
+	CFIndex		i = *ioIndex;
+	
+	if ( i + 2 >= inLength
+			|| !( sCharClasses[ inSource[ i + 1 ] ] & kURLHex )
+			|| !( sCharClasses[ inSource[ i + 2 ] ] & kURLHex ) )
+		return false;
+	
+	inDest[ (*ioOut)++ ] = kURLEscape;
+	inDest[ (*ioOut)++ ] = toupper( inSource[ i + 1 ] );
+	inDest[ (*ioOut)++ ] = toupper( inSource[ i + 2 ] );
+	*ioIndex = i + 2;
+	
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	LowerCase
+//-----------------------------------------------------------------------------
+//
+static UInt8
+LowerCase( UInt8 inChar )
+{
+	return ( inChar >= 'A' && inChar <= 'Z' ) ? inChar + ( 'a' - 'A' ) : inChar;
+}
+
+//-----------------------------------------------------------------------------
+//	IsHostAndPort
+//-----------------------------------------------------------------------------
+//	Whether what looks like a scheme is really a host followed by a port, as
+//	in a web address typed without "http://": the "scheme" has a dot in it,
+//	or the colon is followed by nothing but digits up to the end of the
+//	authority.
+//
+static Boolean
+IsHostAndPort( const UInt8* inSource, CFIndex inLength, CFIndex inSchemeLength )
+{
+	CFIndex		i;
+	
+	if ( memchr( inSource, '.', inSchemeLength ) != NULL )
+		return true;
+	
+	for ( i = inSchemeLength + 1; i < inLength && isdigit( inSource[ i ] ); i++ )
+		;
+	
+	return i > inSchemeLength + 1 && ( i == inLength || inSource[ i ] == '/'
+			|| inSource[ i ] == '?' || inSource[ i ] == '#' );
+}
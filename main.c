@@ -42,8 +42,16 @@
 */
 
 #include <Carbon/Carbon.h>
+#include <mach/mach_time.h>
 
 #include "CustomToolbarItem.h"
+#include "IdleTasks.h"
+#include "ToolbarCatalog.h"
+#include "ToolbarHistory.h"
+#include "ToolbarIcons.h"
+#include "ToolbarMirror.h"
+#include "ToolbarQueue.h"
+#include "ToolbarStats.h"
 
 //-----------------------------------------------------------------------------
 //	Prototypes
@@ -54,9 +62,17 @@ static void			GetToolbarDefaultItems( CFMutableArrayRef array );
 static void			GetToolbarAllowedItems( CFMutableArrayRef array );
 static OSStatus		ToolbarDelegateHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
 static IconRef		RegisterIcon( FourCharCode inCreator, FourCharCode inType, const char* inName );
+static void			RegisterToolbarIcons();
+static IconRef		CopyCachedIconRef( OSType inCreator, OSType inType );
+static Boolean		WarmToolbarIcons( void* inData );
+static void			SetToolbarItemIcon( HIToolbarItemRef inItem, const ToolbarCatalogEntry* inEntry, HIToolbarDisplaySize inSize );
+static void			UpdateToolbarItemIcons( HIToolbarRef inToolbar );
 static OSStatus		CommandHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+static OSStatus		ToolbarWindowHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
+static OSStatus		ToolbarMenuHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
 
-static HIToolbarItemRef			CreateToolbarItemForIdentifier( CFStringRef identifier, CFTypeRef configData );
+static HIToolbarItemRef			CreateToolbarItemForIdentifier( CFStringRef identifier, CFTypeRef configData,
+										HIToolbarDisplaySize displaySize );
 static HIToolbarItemRef			CreateToolbarItemFromDrag( DragRef drag );
 
 static const EventTypeSpec kToolbarEvents[] =
@@ -64,7 +80,8 @@ static const EventTypeSpec kToolbarEvents[] =
 	{ kEventClassToolbar, kEventToolbarGetDefaultIdentifiers },
 	{ kEventClassToolbar, kEventToolbarGetAllowedIdentifiers },
 	{ kEventClassToolbar, kEventToolbarCreateItemWithIdentifier },
-	{ kEventClassToolbar, kEventToolbarCreateItemFromDrag }
+	{ kEventClassToolbar, kEventToolbarCreateItemFromDrag },
+	{ kEventClassToolbar, kEventToolbarDisplaySizeChanged }
 };
 
 static const EventTypeSpec kCommandEvents[] =
@@ -73,6 +90,16 @@ static const EventTypeSpec kCommandEvents[] =
 	{ kEventClassCommand, kEventCommandUpdateStatus }
 };
 
+static const EventTypeSpec kToolbarWindowEvents[] =
+{
+	{ kEventClassWindow, kEventWindowClosed }
+};
+
+static const EventTypeSpec kToolbarMenuEvents[] =
+{
+	{ kEventClassMenu, kEventMenuDispose }
+};
+
 enum
 {
 	kCmdLockToolbar			= 'Lock',
@@ -81,6 +108,31 @@ enum
 };
 
 static void		CreateToolbarWindow();
+static OSStatus		PrepareToolbarWindow( WindowRef* outWindow );
+static void			NoteNewWindowRequest();
+static Boolean		FillWindowPool( void* inData );
+static void			WindowPoolDecayTimer( EventLoopTimerRef inTimer, void* inUserData );
+
+// We keep a few fully built, hidden windows around so that a New command
+// only has to show one. The number we keep follows how often the user has
+// been asking for new windows lately.
+
+enum
+{
+	kMinPooledWindows		= 1,
+	kMaxPooledWindows		= 4,
+	kNewRequestHistory		= 8
+};
+
+#define kNewRequestWindow		( 10 * kEventDurationSecond )
+#define kWindowPoolDeadline		( 1 * kEventDurationSecond )
+
+static WindowRef	sWindowPool[ kMaxPooledWindows ];
+static ItemCount	sPooledWindows;
+static ItemCount	sWindowPoolTarget = kMinPooledWindows;
+static EventTime	sNewRequests[ kNewRequestHistory ];
+static ItemCount	sNextNewRequest;
+static EventLoopTimerRef	sWindowPoolDecayTimer;
 
 static OSStatus 	AppHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData );
 
@@ -109,6 +161,20 @@ int main(int argc, char* argv[])
     DisposeNibReference(nibRef);
 
 	InstallApplicationEventHandler( AppHandler, GetEventTypeCount( kEvents ), kEvents, 0, NULL );
+	InstallToolbarQueue();
+	InstallIdleTasks();
+	InstallToolbarStatsDump();
+	InstallToolbarMirror();
+
+	// When the user stops asking for new windows, we let the window pool
+	// shrink back down. This timer is pushed back with every New command.
+
+	InstallEventLoopTimer( GetMainEventLoop(), kEventDurationForever, kEventDurationForever,
+			NewEventLoopTimerUPP( WindowPoolDecayTimer ), NULL, &sWindowPoolDecayTimer );
+
+	// Register our icons before anybody asks for them, if we get a chance.
+
+	ScheduleIdleTask( WarmToolbarIcons, NULL, kIdleTaskPriorityLow, kEventDurationForever );
 	
 	ProcessHICommand( &command );
 	
@@ -132,6 +198,7 @@ AppHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
 {
 	HICommand		command;
 	OSStatus		result = eventNotHandledErr;
+	UInt64			start = mach_absolute_time();
 	
 	GetEventParameter( inEvent, kEventParamDirectObject, typeHICommand, NULL,
 			sizeof( HICommand ), NULL, &command );
@@ -144,6 +211,11 @@ AppHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
 			break;
 	}
 	
+	// We're the last stop for a command, so we count every one that gets
+	// here, handled or not. That includes those from items nobody handles.
+	
+	ToolbarStatsNoteCommand( command.commandID, start );
+	
 	return result;
 }
 
@@ -161,6 +233,7 @@ CommandHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserDat
 	WindowRef		window = (WindowRef)inUserData;
 	HIToolbarRef	toolbar;
 	UInt32			attrs;
+	UInt64			start = mach_absolute_time();
 	
 	GetEventParameter( inEvent, kEventParamDirectObject, typeHICommand, NULL,
 			sizeof( HICommand ), NULL, &command );
@@ -208,6 +281,24 @@ CommandHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserDat
 							result = noErr;
 						}
 						break;
+					
+					case kHICommandUndo:
+						if ( ToolbarCanUndo( window ) )
+							EnableMenuItem( command.menu.menuRef, command.menu.menuItemIndex );
+						else
+							DisableMenuItem( command.menu.menuRef, command.menu.menuItemIndex );
+						
+						result = noErr;
+						break;
+					
+					case kHICommandRedo:
+						if ( ToolbarCanRedo( window ) )
+							EnableMenuItem( command.menu.menuRef, command.menu.menuItemIndex );
+						else
+							DisableMenuItem( command.menu.menuRef, command.menu.menuItemIndex );
+						
+						result = noErr;
+						break;
 				}
 				break;
 
@@ -237,7 +328,23 @@ CommandHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserDat
 							result = noErr;
 						}
 						break;
+					
+					case kHICommandUndo:
+						ToolbarUndo( window );
+						result = noErr;
+						break;
+					
+					case kHICommandRedo:
+						ToolbarRedo( window );
+						result = noErr;
+						break;
 				}
+				
+				// Commands we don't handle go on to the app, which counts
+				// them there.
+				
+				if ( result == noErr )
+					ToolbarStatsNoteCommand( command.commandID, start );
 				break;
 		}
 	}
@@ -254,47 +361,60 @@ static OSStatus
 InstallToolbar( WindowRef window )
 {
 	OSStatus			err = noErr;
-	static HIToolbarRef	sToolbar = NULL;
+	HIToolbarRef		toolbar;
 
-	// We're going to share one toolbar across each of our windows. We only want
-	// to do the work of creating the toolbar once, so we'll store it in a static.
-	// If the toolbar is non-NULL, that means we already created it in a previous
-	// call to this function.
+	// Each window gets its own toolbar, so that things like locking the toolbar
+	// or changing its display mode only affect that one window. The toolbars
+	// all use the same identifier, which means they all save to and restore
+	// from the same configuration in our prefs. The expensive parts (the lists
+	// of identifiers our delegate hands out and the icons we register) are
+	// built once and shared by every toolbar.
 	
-	if ( sToolbar == NULL )
-	{
-		// OK. Here's the beginning of the fun. Create our toolbar. We want to
-		// automatically save our config to our prefs and we want to allow the
-		// user to customize it.
-	
-		err = HIToolbarCreate( CFSTR( "com.apple.carbontoolbar" ),
-							kHIToolbarAutoSavesConfig | kHIToolbarIsConfigurable,
-							&sToolbar );
-		require_noerr( err, CantCreateToolbar );
-	
-		// Now, a toolbar all by its lonesome is nothing to behold. You need to
-		// add some items. The toolbar does this via a delegate. The delegate is
-		// asked to supply items as they are needed by the toolbar. It is also
-		// responsible for providing the default set of items, and the set of
-		// allowable items (which is shown in the config sheet). Any HIObjectRef
-		// can be the toolbar's delegate. The toolbar simply needs a place to
-		// which it can send the appropriate carbon events. By default, the
-		// toolbar starts out as its own delegate. You can change the delegate
-		// to another HIObjectRef with the HIToolbarSetDelegate API if you wish.
-		
-		// For our purposes, we're fine with the default behavior of the toolbar
-		// being its own delegate. All we need to do is install a carbon event
-		// handler on the toolbar so we can handle the delegate events that the
-		// toolbar sends out.
-		
-		InstallEventHandler( HIObjectGetEventTarget( sToolbar ), ToolbarDelegateHandler,
-				GetEventTypeCount( kToolbarEvents ), kToolbarEvents, sToolbar, NULL );
-	}
+	// OK. Here's the beginning of the fun. Create our toolbar. We want to
+	// automatically save our config to our prefs and we want to allow the
+	// user to customize it.
+
+	err = HIToolbarCreate( CFSTR( "com.apple.carbontoolbar" ),
+						kHIToolbarAutoSavesConfig | kHIToolbarIsConfigurable,
+						&toolbar );
+	require_noerr( err, CantCreateToolbar );
+
+	// Now, a toolbar all by its lonesome is nothing to behold. You need to
+	// add some items. The toolbar does this via a delegate. The delegate is
+	// asked to supply items as they are needed by the toolbar. It is also
+	// responsible for providing the default set of items, and the set of
+	// allowable items (which is shown in the config sheet). Any HIObjectRef
+	// can be the toolbar's delegate. The toolbar simply needs a place to
+	// which it can send the appropriate carbon events. By default, the
+	// toolbar starts out as its own delegate. You can change the delegate
+	// to another HIObjectRef with the HIToolbarSetDelegate API if you wish.
+	
+	// For our purposes, we're fine with the default behavior of the toolbar
+	// being its own delegate. All we need to do is install a carbon event
+	// handler on the toolbar so we can handle the delegate events that the
+	// toolbar sends out.
+	
+	InstallEventHandler( HIObjectGetEventTarget( toolbar ), ToolbarDelegateHandler,
+			GetEventTypeCount( kToolbarEvents ), kToolbarEvents, toolbar, NULL );
 				
-	// Now we just attach the toolbar to the window and make it visible.
+	// Now we just attach the toolbar to the window and make it visible. The
+	// window retains the toolbar, so we can let go of our reference and the
+	// toolbar will go away along with the window.
 
-	SetWindowToolbar( window, sToolbar );
+	SetWindowToolbar( window, toolbar );
 	ShowHideWindowToolbar( window, true, false );
+	CFRelease( toolbar );
+
+	// Count the toolbar in our stats until its window closes.
+	
+	ToolbarStatsAdd( kToolbarStatsToolbars, 1, 0 );
+	InstallWindowEventHandler( window, ToolbarWindowHandler, GetEventTypeCount( kToolbarWindowEvents ),
+			kToolbarWindowEvents, NULL, NULL );
+
+	// Keep track of how the user customizes this toolbar so the changes can
+	// be undone.
+	
+	InstallToolbarHistory( window );
 
 	// Now add the toolbar widget to the window. We could also just specify
 	// it in the nib file, but let's do it programmatically.
@@ -309,6 +429,32 @@ CantCreateToolbar:
 	return err;
 }
 
+//-----------------------------------------------------------------------------
+//	ToolbarWindowHandler
+//-----------------------------------------------------------------------------
+//	The window (and so its toolbar) is going away.
+//
+static OSStatus
+ToolbarWindowHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
+{
+	ToolbarStatsAdd( kToolbarStatsToolbars, -1, 0 );
+	
+	return eventNotHandledErr;
+}
+
+//-----------------------------------------------------------------------------
+//	ToolbarMenuHandler
+//-----------------------------------------------------------------------------
+//	An item's menu is going away along with its item.
+//
+static OSStatus
+ToolbarMenuHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* inUserData )
+{
+	ToolbarStatsAdd( kToolbarStatsMenus, -1, 0 );
+	
+	return eventNotHandledErr;
+}
+
 //-----------------------------------------------------------------------------
 //	ToolbarDelegateHandler
 //-----------------------------------------------------------------------------
@@ -343,14 +489,21 @@ ToolbarDelegateHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* i
 			{
 				HIToolbarItemRef		item;
 				CFTypeRef				data = NULL;
+				HIToolbarDisplaySize	size = kHIToolbarDisplaySizeDefault;
 				
 				GetEventParameter( inEvent, kEventParamToolbarItemIdentifier, typeCFStringRef, NULL,
 						sizeof( CFStringRef ), NULL, &identifier );
 				
 				GetEventParameter( inEvent, kEventParamToolbarItemConfigData, typeCFTypeRef, NULL,
 						sizeof( CFTypeRef ), NULL, &data );
-					
-				item = CreateToolbarItemForIdentifier( identifier, data );
+				
+				// When restoring a saved configuration, the toolbar reads it
+				// itself and asks us for the items one at a time, in order, so
+				// each item can show up as soon as it is made. We only ever see
+				// one item's config data, and we hand it straight on.
+				
+				HIToolbarGetDisplaySize( (HIToolbarRef)inUserData, &size );
+				item = CreateToolbarItemForIdentifier( identifier, data, size );
 				
 				if ( item )
 				{
@@ -379,6 +532,13 @@ ToolbarDelegateHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* i
 				}
 			}
 			break;
+		
+		case kEventToolbarDisplaySizeChanged:
+			// Give our items their icons drawn at the new size. We leave the
+			// event unhandled, since the toolbar history watches for it too.
+			
+			UpdateToolbarItemIcons( (HIToolbarRef)inUserData );
+			break;
 	}
 
 	return result;
@@ -395,11 +555,9 @@ ToolbarDelegateHandler( EventHandlerCallRef inCallRef, EventRef inEvent, void* i
 static void
 GetToolbarDefaultItems( CFMutableArrayRef array )
 {
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.anchored" ) );
-	CFArrayAppendValue( array, kHIToolbarSeparatorIdentifier );
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.permanent" ) );
-	CFArrayAppendValue( array, kHIToolbarFlexibleSpaceIdentifier );
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.trash" ) );
+	CFArrayRef		items = GetToolbarCatalogDefaultItems();
+	
+	CFArrayAppendArray( array, items, CFRangeMake( 0, CFArrayGetCount( items ) ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -414,16 +572,9 @@ GetToolbarDefaultItems( CFMutableArrayRef array )
 static void
 GetToolbarAllowedItems( CFMutableArrayRef array )
 {
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.newdocument" ) );
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.anchored" ) );
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.permanent" ) );
-	CFArrayAppendValue( array, CFSTR( "com.apple.carbontoolbar.trash" ) );
-	CFArrayAppendValue( array, kHIToolbarSeparatorIdentifier );
-	CFArrayAppendValue( array, kHIToolbarSpaceIdentifier );
-	CFArrayAppendValue( array, kHIToolbarFlexibleSpaceIdentifier );
-	CFArrayAppendValue( array, kHIToolbarCustomizeIdentifier );
-	CFArrayAppendValue( array, kHIToolbarPrintItemIdentifier );
-	CFArrayAppendValue( array, kHIToolbarFontsItemIdentifier );
+	CFArrayRef		items = GetToolbarCatalogAllowedItems();
+	
+	CFArrayAppendArray( array, items, CFRangeMake( 0, CFArrayGetCount( items ) ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -437,108 +588,47 @@ GetToolbarAllowedItems( CFMutableArrayRef array )
 //	at which point the toolbar will try to create one of its default items.
 //
 static HIToolbarItemRef
-CreateToolbarItemForIdentifier( CFStringRef identifier, CFTypeRef configData )
+CreateToolbarItemForIdentifier( CFStringRef identifier, CFTypeRef configData, HIToolbarDisplaySize displaySize )
 {
-	HIToolbarItemRef		item = NULL;
-		
-	if ( CFStringCompare( CFSTR( "com.apple.carbontoolbar.permanent" ),
-				identifier, kCFCompareBackwards ) == kCFCompareEqualTo )
-	{		
-		// This item is marked as 'can't be removed'. This means the user can reposition
-		// it in the toolbar, but it can't be dragged out or removed through the toolbar
-		// context menu.
-
-		if ( HIToolbarItemCreate( identifier, kHIToolbarItemCantBeRemoved, &item ) == noErr )
-		{
-			IconRef		icon;
-			
-			GetIconRef( kOnSystemDisk, kSystemIconsCreator, kFinderIcon, &icon );
-			HIToolbarItemSetLabel( item, CFSTR( "Can't Remove Me" ) );
-			HIToolbarItemSetIconRef( item, icon );
-			HIToolbarItemSetCommandID( item, 'SHRT' );
-			ReleaseIconRef( icon );
-		}
+	HIToolbarItemRef			item = NULL;
+	const ToolbarCatalogEntry*	entry;
+	
+	// Everything we need to know about our items is in the catalog (see
+	// ToolbarCatalog.c), so all we do here is look the item up and build it.
+	
+	entry = FindToolbarCatalogEntry( identifier );
+	if ( entry == NULL )
+		return NULL;
+	
+	if ( entry->kind == kToolbarCatalogURLItem )
+	{
+		item = CreateCustomToolbarItem( entry->identifier, configData );
 	}
-
-	if ( CFStringCompare( CFSTR( "com.apple.carbontoolbar.anchored" ),
-				identifier, kCFCompareBackwards ) == kCFCompareEqualTo )
+	else if ( HIToolbarItemCreate( identifier, entry->attributes, &item ) == noErr )
 	{
-		// As an example, this item is marked as 'anchored left'. This means that it is not
-		// only immovable, but nothing can be dragged in front of it either. For it to truly
-		// work right, you need to have the items marked as such as the leftmost items. If you
-		// allow a non-anchored item to be to the left of one of these, it gets a little weird.
-		// This attribute is to make toolbars like the one in System Preferences, where the
-		// Show All and the separator after it are fixed in place.
-
-		if ( HIToolbarItemCreate( identifier, kHIToolbarItemAnchoredLeft, &item ) == noErr )
-		{
-			IconRef			icon;
-			MenuRef			menu;
-			static bool		sRegisteredIcon;
+		if ( entry->iconFile != NULL )
+			RegisterToolbarIcons();
 		
-			if ( !sRegisteredIcon )
-			{
-				RegisterIcon( 'CTba', kHICommandCut, "cut.icns" );
-				sRegisteredIcon = true;
-			}
-			
-			GetIconRef( kOnSystemDisk, 'CTba', kHICommandCut, &icon );
-			HIToolbarItemSetLabel( item, CFSTR( "Anchored" ) );
-			HIToolbarItemSetCommandID( item, kHICommandCut );
-			HIToolbarItemSetIconRef( item, icon );
+		HIToolbarItemSetLabel( item, entry->label );
+		HIToolbarItemSetCommandID( item, entry->commandID );
+		SetToolbarItemIcon( item, entry, displaySize );
+		
+		if ( entry->menuItems != NULL )
+		{
+			const CFStringRef*	menuItem;
+			MenuRef				menu;
 			
-			// For this item, we also attach a menu. This menu is used when the
-			// item is clipped (and the 'more items' indicator is showing), as
-			// well as when the toolbar is in text only mode.
-	
 			menu = NewMenu( 0, "\p" );
-			AppendMenuItemTextWithCFString( menu, CFSTR( "Item 1" ), 0, 0, NULL );
-			AppendMenuItemTextWithCFString( menu, CFSTR( "Item 2" ), 0, 0, NULL );
-			AppendMenuItemTextWithCFString( menu, CFSTR( "Item 3" ), 0, 0, NULL );
+			for ( menuItem = entry->menuItems; *menuItem != NULL; menuItem++ )
+				AppendMenuItemTextWithCFString( menu, *menuItem, 0, 0, NULL );
 			HIToolbarItemSetMenu( item, menu );
-			ReleaseMenu( menu );
-
-			ReleaseIconRef( icon );
-		}
-	}
-
-	if ( CFStringCompare( CFSTR( "com.apple.carbontoolbar.trash" ),
-				identifier, kCFCompareBackwards ) == kCFCompareEqualTo )
-	{
-		// This item has no fancy stuff at all.
-
-		if ( HIToolbarItemCreate( identifier, kHIToolbarItemNoAttributes, &item ) == noErr )
-		{
-			IconRef		icon;
 			
-			GetIconRef( kOnSystemDisk, kSystemIconsCreator, kTrashIcon, &icon );
-			HIToolbarItemSetLabel( item, CFSTR( "Trash" ) );
-			HIToolbarItemSetCommandID( item, 'TRSH' );
-			HIToolbarItemSetIconRef( item, icon );
-			ReleaseIconRef( icon );
-		}
-	}
-
-	if ( CFStringCompare( CFSTR( "com.apple.carbontoolbar.newdocument" ),
-				identifier, kCFCompareBackwards ) == kCFCompareEqualTo )
-	{
-		if ( HIToolbarItemCreate( identifier, kHIToolbarItemNoAttributes, &item ) == noErr )
-		{
-			IconRef		icon;
-			
-			GetIconRef( kOnSystemDisk, kSystemIconsCreator, kGenericDocumentIcon, &icon );
-			HIToolbarItemSetLabel( item, CFSTR( "New Document" ) );
-			HIToolbarItemSetCommandID( item, kHICommandNew );
-			HIToolbarItemSetIconRef( item, icon );
-			ReleaseIconRef( icon );
+			ToolbarStatsAdd( kToolbarStatsMenus, 1, 0 );
+			InstallMenuEventHandler( menu, ToolbarMenuHandler, GetEventTypeCount( kToolbarMenuEvents ),
+					kToolbarMenuEvents, NULL, NULL );
+			ReleaseMenu( menu );
 		}
 	}
-
-	if ( CFStringCompare( CFSTR( "MyCustomIdentifier" ),
-				identifier, kCFCompareBackwards ) == kCFCompareEqualTo )
-	{
-		item = CreateCustomToolbarItem( CFSTR( "MyCustomIdentifier" ), configData );
-	}
 	
 	return item;
 }
@@ -588,7 +678,9 @@ CreateToolbarItemFromDrag( DragRef drag )
 //-----------------------------------------------------------------------------
 //	RegisterIcon
 //-----------------------------------------------------------------------------
-//	Utility routine to register an icns file.
+//	Utility routine to register an icns file. The icon isn't counted in our
+//	stats here; that happens when CopyCachedIconRef first looks it up, as for
+//	any other icon.
 //
 static IconRef
 RegisterIcon( FourCharCode inCreator, FourCharCode inType, const char* inName )
@@ -627,12 +719,221 @@ RegisterIcon( FourCharCode inCreator, FourCharCode inType, const char* inName )
 	return result;
 }
 
+//-----------------------------------------------------------------------------
+//	RegisterToolbarIcons
+//-----------------------------------------------------------------------------
+//	Register the icons our items use from our bundle. We take care to only
+//	do this once.
+//
+static void
+RegisterToolbarIcons()
+{
+	static bool		sRegisteredIcons;
+	ItemCount		i;
+	
+	if ( !sRegisteredIcons )
+	{
+		for ( i = 0; i < kToolbarCatalogCount; i++ )
+		{
+			if ( kToolbarCatalog[ i ].iconFile != NULL )
+				RegisterIcon( kToolbarCatalog[ i ].iconCreator, kToolbarCatalog[ i ].iconType,
+						kToolbarCatalog[ i ].iconFile );
+		}
+		sRegisteredIcons = true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	CopyCachedIconRef
+//-----------------------------------------------------------------------------
+//	Every time the configuration sheet opens, the toolbar creates one of each
+//	of our allowed items to fill its palette, and throws them away again when
+//	the sheet closes. So that doing this is cheap, we look each icon up only
+//	once and hang onto it from then on. The caller gets its own reference,
+//	and must release it once it has handed the icon to the item.
+//
+static IconRef
+CopyCachedIconRef( OSType inCreator, OSType inType )
+{
+	enum { kMaxCachedIcons = 16 };
+	
+	static struct
+	{
+		OSType		creator;
+		OSType		type;
+		IconRef		icon;
+	}					sIcons[ kMaxCachedIcons ];
+	static ItemCount	sIconCount;
+	ItemCount			i;
+	IconRef				icon = NULL;
+	
+	for ( i = 0; i < sIconCount; i++ )
+	{
+		if ( sIcons[ i ].creator == inCreator && sIcons[ i ].type == inType )
+		{
+			AcquireIconRef( sIcons[ i ].icon );
+			return sIcons[ i ].icon;
+		}
+	}
+	
+	if ( GetIconRef( kOnSystemDisk, inCreator, inType, &icon ) != noErr )
+		icon = NULL;
+	
+	// If we are out of room, the caller's reference is the only one, and the
+	// icon goes away once the items using it do.
+	
+	if ( icon != NULL && sIconCount < kMaxCachedIcons )
+	{
+		AcquireIconRef( icon );
+		sIcons[ sIconCount ].creator = inCreator;
+		sIcons[ sIconCount ].type = inType;
+		sIcons[ sIconCount ].icon = icon;
+		sIconCount++;
+		
+		ToolbarStatsAdd( kToolbarStatsIcons, 1, 0 );
+	}
+	
+	return icon;
+}
+
+//-----------------------------------------------------------------------------
+//	WarmToolbarIcons
+//-----------------------------------------------------------------------------
+//	Idle task that looks up our icons ahead of time, and draws them at each
+//	toolbar size, so that creating the first item that needs one doesn't have
+//	to go to disk for it. We look up one catalog entry per call, and draw
+//	them all once we have them.
+//
+static Boolean
+WarmToolbarIcons( void* inData )
+{
+	enum { kMaxWarmIcons = 16 };
+	
+	static IconRef		sIcons[ kMaxWarmIcons ];
+	static ItemCount	sIconCount;
+	static ItemCount	sNextEntry;
+	
+	RegisterToolbarIcons();
+	
+	if ( sNextEntry < kToolbarCatalogCount )
+	{
+		if ( kToolbarCatalog[ sNextEntry ].kind == kToolbarCatalogStandardItem && sIconCount < kMaxWarmIcons )
+		{
+			IconRef		icon;
+			
+			icon = CopyCachedIconRef( kToolbarCatalog[ sNextEntry ].iconCreator, kToolbarCatalog[ sNextEntry ].iconType );
+			if ( icon )
+				sIcons[ sIconCount++ ] = icon;
+		}
+		sNextEntry++;
+		
+		return false;
+	}
+	
+	// Now that we have them all, draw them together, so that they share one
+	// page per size.
+	
+	PrepareToolbarIconImages( sIcons, sIconCount );
+	while ( sIconCount > 0 )
+		ReleaseIconRef( sIcons[ --sIconCount ] );
+	
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	SetToolbarItemIcon
+//-----------------------------------------------------------------------------
+//	Give an item its catalog icon, as drawn for the toolbar's size. If we
+//	couldn't draw the icon ourselves, the item gets the IconRef and the
+//	toolbar scales it as it draws.
+//
+static void
+SetToolbarItemIcon( HIToolbarItemRef inItem, const ToolbarCatalogEntry* inEntry, HIToolbarDisplaySize inSize )
+{
+	IconRef			icon = CopyCachedIconRef( inEntry->iconCreator, inEntry->iconType );
+	CGImageRef		image = GetToolbarIconImage( icon, inSize );
+	
+	if ( image )
+		HIToolbarItemSetImage( inItem, image );
+	else if ( icon )
+		HIToolbarItemSetIconRef( inItem, icon );
+	
+	if ( icon )
+		ReleaseIconRef( icon );
+}
+
+//-----------------------------------------------------------------------------
+//	UpdateToolbarItemIcons
+//-----------------------------------------------------------------------------
+//	The toolbar changed size. Our icons are already drawn at every size, so
+//	all this does is hand each of our items the other image.
+//
+static void
+UpdateToolbarItemIcons( HIToolbarRef inToolbar )
+{
+	HIToolbarDisplaySize	size = kHIToolbarDisplaySizeDefault;
+	CFArrayRef				items;
+	CFIndex					i;
+	
+	HIToolbarGetDisplaySize( inToolbar, &size );
+	require_noerr( HIToolbarCopyItems( inToolbar, &items ), CantCopyItems );
+	
+	for ( i = 0; i < CFArrayGetCount( items ); i++ )
+	{
+		HIToolbarItemRef			item = (HIToolbarItemRef)CFArrayGetValueAtIndex( items, i );
+		const ToolbarCatalogEntry*	entry;
+		CFStringRef					identifier;
+		
+		if ( HIToolbarItemCopyIdentifier( item, &identifier ) == noErr )
+		{
+			entry = FindToolbarCatalogEntry( identifier );
+			if ( entry != NULL && entry->kind == kToolbarCatalogStandardItem )
+				SetToolbarItemIcon( item, entry, size );
+			CFRelease( identifier );
+		}
+	}
+	
+	CFRelease( items );
+
+CantCopyItems:
+	return;
+}
+
 //-----------------------------------------------------------------------------
 //	CreateToolbarWindow
 //-----------------------------------------------------------------------------
+//	Show a new toolbar window. If we have one waiting in our pool, we hand it
+//	out right away. Otherwise we have to build one on the spot.
 //
 static void
 CreateToolbarWindow()
+{
+	WindowRef		window = NULL;
+	
+	NoteNewWindowRequest();
+	
+	if ( sPooledWindows > 0 )
+	{
+		window = sWindowPool[ --sPooledWindows ];
+		sWindowPool[ sPooledWindows ] = NULL;
+	}
+	else if ( PrepareToolbarWindow( &window ) != noErr )
+	{
+		window = NULL;
+	}
+	
+	if ( window )
+		ShowWindow( window );
+}
+
+//-----------------------------------------------------------------------------
+//	PrepareToolbarWindow
+//-----------------------------------------------------------------------------
+//	Build a window with its command handler and toolbar all in place, but leave
+//	it hidden. This is everything a New command needs short of showing it.
+//
+static OSStatus
+PrepareToolbarWindow( WindowRef* outWindow )
 {
 	IBNibRef		nibRef;
 	OSStatus		err;
@@ -645,6 +946,10 @@ CreateToolbarWindow()
     require_noerr( err, CantGetNibRef );
     
     err = CreateWindowFromNib( nibRef, CFSTR("MainWindow"), &window );
+
+    // We don't need the nib reference anymore.
+    DisposeNibReference(nibRef);
+
     require_noerr( err, CantCreateWindow );
 
 	// Install a handler to deal with the toolbar menu
@@ -652,16 +957,87 @@ CreateToolbarWindow()
 	InstallWindowEventHandler( window, CommandHandler, GetEventTypeCount( kCommandEvents ),
 			kCommandEvents, window, NULL );
 
-    // We don't need the nib reference anymore.
-    DisposeNibReference(nibRef);
-	
-    // The window was created hidden so show it.
-    ShowWindow( window );
+	// Install our toolbar. The window was created hidden, and we leave it
+	// that way until somebody asks for it.
 
-	// Install our toolbar
 	InstallToolbar( window );
+	
+	*outWindow = window;
 
 CantCreateWindow:
 CantGetNibRef:
-	return;
+	return err;
+}
+
+//-----------------------------------------------------------------------------
+//	NoteNewWindowRequest
+//-----------------------------------------------------------------------------
+//	Remember when the user asked for a new window, and size our pool to match.
+//	We keep one spare window for every request in the last few seconds (plus
+//	our minimum), so a burst of New commands finds windows waiting for it.
+//
+static void
+NoteNewWindowRequest()
+{
+	EventTime		now = GetCurrentEventTime();
+	ItemCount		i, recent = 0;
+	
+	sNewRequests[ sNextNewRequest ] = now;
+	sNextNewRequest = ( sNextNewRequest + 1 ) % kNewRequestHistory;
+	
+	for ( i = 0; i < kNewRequestHistory; i++ )
+	{
+		if ( sNewRequests[ i ] != 0 && now - sNewRequests[ i ] < kNewRequestWindow )
+			recent++;
+	}
+	
+	sWindowPoolTarget = kMinPooledWindows + recent - 1;
+	if ( sWindowPoolTarget > kMaxPooledWindows )
+		sWindowPoolTarget = kMaxPooledWindows;
+	
+	// Refill the pool when the user gives us a moment. If they keep us busy,
+	// we refill it anyway after a second, since the next New is coming.
+	
+	ScheduleIdleTask( FillWindowPool, NULL, kIdleTaskPriorityHigh, now + kWindowPoolDeadline );
+	SetEventLoopTimerNextFireTime( sWindowPoolDecayTimer, kNewRequestWindow );
+}
+
+//-----------------------------------------------------------------------------
+//	FillWindowPool
+//-----------------------------------------------------------------------------
+//	Idle task that brings the pool to its target size. We build (or throw
+//	away) one window per call, so we never hold up the event loop for long.
+//
+static Boolean
+FillWindowPool( void* inData )
+{
+	if ( sPooledWindows < sWindowPoolTarget )
+	{
+		WindowRef		window;
+		
+		if ( PrepareToolbarWindow( &window ) == noErr )
+			sWindowPool[ sPooledWindows++ ] = window;
+		else
+			return true;
+	}
+	else if ( sPooledWindows > sWindowPoolTarget )
+	{
+		DisposeWindow( sWindowPool[ --sPooledWindows ] );
+		sWindowPool[ sPooledWindows ] = NULL;
+	}
+	
+	return sPooledWindows == sWindowPoolTarget;
+}
+
+//-----------------------------------------------------------------------------
+//	WindowPoolDecayTimer
+//-----------------------------------------------------------------------------
+//	The user hasn't asked for a window in a while. Let the pool drift back to
+//	its minimum size.
+//
+static void
+WindowPoolDecayTimer( EventLoopTimerRef inTimer, void* inUserData )
+{
+	sWindowPoolTarget = kMinPooledWindows;
+	ScheduleIdleTask( FillWindowPool, NULL, kIdleTaskPriorityNormal, kEventDurationForever );
 }